@@ -74,6 +74,8 @@ SOURCES += \
     src/gui/SimpleParser/SimpleParserEditor.cpp \
     src/gui/SimpleParser/SimpleParserGUIExecuteObject.cpp \
     src/gui/SimpleParser/SimpleParserGUIObject.cpp \
+    src/gui/SimpleParser/SimpleParserProfileWidget.cpp \
+    src/gui/SimpleParser/SimpleParserTestWidget.cpp \
     src/gui/SimpleTextGenerator/STGAliasListWidget.cpp \
     src/gui/SimpleTextGenerator/STGEditor.cpp \
     src/gui/SimpleTextGenerator/STGFragmentInputWidget.cpp \
@@ -109,6 +111,7 @@ SOURCES += \
     src/main.cpp \
     src/gui/EditorWindow.cpp \
     src/misc/MessageLogger.cpp \
+    src/misc/ParserBenchmark.cpp \
     src/misc/Settings.cpp \
     src/utils/EventLoopHelper.cpp \
     src/utils/NameSorting.cpp \
@@ -147,6 +150,8 @@ HEADERS += \
     src/gui/SimpleParser/SimpleParserEditor.h \
     src/gui/SimpleParser/SimpleParserGUIExecuteObject.h \
     src/gui/SimpleParser/SimpleParserGUIObject.h \
+    src/gui/SimpleParser/SimpleParserProfileWidget.h \
+    src/gui/SimpleParser/SimpleParserTestWidget.h \
     src/gui/SimpleTextGenerator/STGAliasListWidget.h \
     src/gui/SimpleTextGenerator/STGEditor.h \
     src/gui/SimpleTextGenerator/STGFragmentInputWidget.h \
@@ -180,10 +185,12 @@ HEADERS += \
     src/lib/Tree/SimpleTreeTransform.h \
     src/lib/Tree/Tree.h \
     src/misc/MessageLogger.h \
+    src/misc/ParserBenchmark.h \
     src/misc/Settings.h \
     src/utils/BidirStringList.h \
     src/utils/ContiguousIndexVector.h \
     src/utils/EventLoopHelper.h \
+    src/utils/FunctionRunnable.h \
     src/utils/NameSorting.h \
     src/utils/TextUtilities.h \
     src/utils/XMLUtilities.h
@@ -216,7 +223,7 @@ TRANSLATIONS += \
 # Platform dependent sources
 win32 {
     SOURCES += src/misc/MessageLogger_Windows.cpp
-    LIBS += -lDbgHelp
+    LIBS += -lDbgHelp -lPsapi
 } else: emscripten {
     SOURCES += src/misc/MessageLogger_WebAssembly.cpp
 } else: unix {
@@ -3,6 +3,7 @@
 
 #include <QLabel>
 #include <QMessageBox>
+#include <QVBoxLayout>
 
 ExecuteOptionDialog::ExecuteOptionDialog(
     const TaskObject* task,
@@ -30,10 +31,17 @@ ExecuteOptionDialog::ExecuteOptionDialog(
 
     resolveReferenceCB(std::bind(ObjectContext::resolveNamedReference, std::placeholders::_1, rootNameSpace, ctxPtr)),
 
-    inputLayout(new QFormLayout)
+    inputLayout(new QFormLayout),
+    profileCheckBox(new QCheckBox(tr("Collect profiling data")))
 {
     ui->setupUi(this);
     ui->inputGroupBox->setLayout(inputLayout);
+    {
+        QVBoxLayout* launchOptionLayout = new QVBoxLayout;
+        profileCheckBox->setChecked(options.flags & TaskObject::LaunchFlag::Run_CollectProfile);
+        launchOptionLayout->addWidget(profileCheckBox);
+        ui->launchOptionGroupBox->setLayout(launchOptionLayout);
+    }
     QObject::connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &ExecuteOptionDialog::tryAccept);
 
     const ConfigurationDeclaration* configDecl = nullptr;
@@ -206,5 +214,6 @@ void ExecuteOptionDialog::tryAccept()
     }
 
     // everything good
+    options.flags.setFlag(TaskObject::LaunchFlag::Run_CollectProfile, profileCheckBox->isChecked());
     accept();
 }
@@ -3,6 +3,7 @@
 
 #include <QDialog>
 #include <QFormLayout>
+#include <QCheckBox>
 
 #include "src/lib/ObjectContext.h"
 #include "src/lib/TaskObject.h"
@@ -77,6 +78,7 @@ private:
     QHash<QString, int> taskOutputNameToIndex;
     QFormLayout* inputLayout;
     QHash<QString, ObjectInputEdit*> inputEdits; // only for "scalar" (not batch) inputs
+    QCheckBox* profileCheckBox;
 
 };
 
@@ -26,6 +26,7 @@ ImportFileDialog::~ImportFileDialog()
 void ImportFileDialog::setSrc(const QByteArray &srcBA)
 {
     src = srcBA;
+    srcFileSize = srcBA.size();
 
     int cnt = 0;
     for(int i = 0, n = openTypes.size(); i < n; ++i) {
@@ -80,7 +81,7 @@ void ImportFileDialog::tryOpen()
             return;
         }
     }
-    if (ImportedObject* obj = FileImportSupportDecl::getInstanceVec().at(index)->import(src, importConfig)) {
+    if (ImportedObject* obj = FileImportSupportDecl::getInstanceVec().at(index)->importFile(srcFilePath, srcFileSize, src, importConfig)) {
         result = obj;
         accept();
     } else {
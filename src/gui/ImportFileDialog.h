@@ -19,6 +19,8 @@ class ImportFileDialog : public QDialog
 public:
     explicit ImportFileDialog(QWidget *parent = nullptr);
     void setSrc(const QByteArray& srcBA);
+    // the file src comes from, if any; src can be a view of only the beginning of it
+    void setSrcFile(const QString& path, qint64 size) {srcFilePath = path; srcFileSize = size;}
     ~ImportFileDialog();
 
     ImportedObject* getResult() const {return result;}
@@ -39,6 +41,8 @@ private:
 
     ImportedObject* result = nullptr;
     QByteArray src;
+    QString srcFilePath;
+    qint64 srcFileSize = 0;
 };
 
 #endif // IMPORTFILEDIALOG_H
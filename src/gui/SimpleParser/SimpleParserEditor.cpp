@@ -27,6 +27,12 @@ SimpleParserEditor::SimpleParserEditor(QWidget *parent) :
     });
     contentCtl.setCreateWidgetCallback(std::bind(&SimpleParserEditor::createContentInputWidget, this, std::placeholders::_1));
     connect(contentCtl.getObj(), &NamedElementListControllerObject::dirty, this, &EditorBase::setDirty);
+
+    testWidget = new SimpleParserTestWidget;
+    testWidget->setDataCallback(std::bind(&SimpleParserEditor::getCurrentData, this));
+    ui->tabWidget->addTab(testWidget, tr("Test"));
+    connect(this, &EditorBase::dirty,                   testWidget, &SimpleParserTestWidget::invalidateGrammar);
+    connect(this, &SimpleParserEditor::initComplete,    testWidget, &SimpleParserTestWidget::invalidateGrammar);
 }
 
 SimpleParserEditor::~SimpleParserEditor()
@@ -88,18 +94,25 @@ bool SimpleParserEditor::inputValidationCallback_NamedBoundary(const QString& na
     return markCtl.isElementExist(name);
 }
 
-void SimpleParserEditor::saveToObjectRequested(ObjectBase* obj)
+SimpleParser::Data SimpleParserEditor::getCurrentData()
 {
-    SimpleParserGUIObject* castedObj = qobject_cast<SimpleParserGUIObject*>(obj);
-    Q_ASSERT(backingObj == castedObj);
+    Q_ASSERT(backingObj);
 
     // TODO add settings and others
-    auto data = castedObj->getData();
+    SimpleParser::Data data = backingObj->getData();
     ruleCtl.getData(data.matchRuleNodes);
     contentCtl.getData(data.contentTypes);
     markCtl.getData(data.namedBoundaries);
     graphData.getData(data); // save after ruleCtl so that rules are already there
-    castedObj->setData(data);
+    return data;
+}
+
+void SimpleParserEditor::saveToObjectRequested(ObjectBase* obj)
+{
+    SimpleParserGUIObject* castedObj = qobject_cast<SimpleParserGUIObject*>(obj);
+    Q_ASSERT(backingObj == castedObj);
+
+    castedObj->setData(getCurrentData());
 }
 
 void SimpleParserEditor::setBackingObject(SimpleParserGUIObject* obj)
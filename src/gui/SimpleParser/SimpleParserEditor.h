@@ -8,6 +8,7 @@
 #include "src/gui/SimpleParser/SPRuleInputWidget.h"
 #include "src/gui/SimpleParser/SPMarkInputWidget.h"
 #include "src/gui/SimpleParser/SPContentInputWidget.h"
+#include "src/gui/SimpleParser/SimpleParserTestWidget.h"
 
 #include <QWidget>
 
@@ -95,6 +96,9 @@ private:
     } graphData;
 
 private:
+    // the grammar as currently shown in the editor
+    SimpleParser::Data getCurrentData();
+
     SPRuleInputWidget* createRuleInputWidget(HierarchicalElementTreeControllerObject* obj);
     SPMarkInputWidget* createMarkInputWidget(NamedElementListControllerObject* obj);
     SPContentInputWidget* createContentInputWidget(NamedElementListControllerObject* obj);
@@ -109,6 +113,7 @@ private:
     NamedElementListController<SPMarkInputWidget, true> markCtl;
     NamedElementListController<SPContentInputWidget, true> contentCtl;
     SPRuleInputWidget::CommonHelperData ruleCommonHelper;
+    SimpleParserTestWidget* testWidget = nullptr;
 };
 
 #endif // SIMPLEPARSEREDITOR_H
@@ -1,4 +1,7 @@
 #include "SimpleParserGUIExecuteObject.h"
+#include "src/gui/SimpleParser/SimpleParserProfileWidget.h"
+
+#include <QTabWidget>
 
 SimpleParserViewDelegateObject::SimpleParserViewDelegateObject(SimpleParserGUIExecuteObject *p)
     : parent(p),
@@ -46,8 +49,8 @@ QString SimpleParserViewDelegateObject::getLocationDescriptionString(int objectI
     }
 }
 
-SimpleParserGUIExecuteObject::SimpleParserGUIExecuteObject(const SimpleParser::Data& dataArg, QString name)
-    : SimpleParserExecuteObject(dataArg, name)
+SimpleParserGUIExecuteObject::SimpleParserGUIExecuteObject(const SimpleParser::GrammarPointer& grammar, QString name)
+    : SimpleParserExecuteObject(grammar, name)
 {
 
 }
@@ -71,9 +74,20 @@ QWidget* SimpleParserGUIExecuteObject::getViewer()
     TransformPassViewWidget* w = new TransformPassViewWidget;
     w->installDelegateObject(delegate);
     connect(this, &SimpleParserGUIExecuteObject::guiDataReady, w, &TransformPassViewWidget::dataReady);
+    QWidget* viewer = w;
+    if (isProfilingEnabled()) {
+        SimpleParserProfileWidget* profileWidget = new SimpleParserProfileWidget;
+        connect(this, &SimpleParserGUIExecuteObject::guiDataReady, profileWidget, [=](){
+            profileWidget->setReport(getProfileReport());
+        });
+        QTabWidget* tabs = new QTabWidget;
+        tabs->addTab(w, tr("Events"));
+        tabs->addTab(profileWidget, tr("Profile"));
+        viewer = tabs;
+    }
     if (logger) {
         // we already completed one run
         emit guiDataReady(logger);
     }
-    return w;
+    return viewer;
 }
@@ -14,7 +14,7 @@ class SimpleParserGUIExecuteObject : public SimpleParserExecuteObject
 {
     Q_OBJECT
 public:
-    SimpleParserGUIExecuteObject(const SimpleParser::Data& dataArg, QString name);
+    SimpleParserGUIExecuteObject(const SimpleParser::GrammarPointer& grammar, QString name);
 
     virtual ~SimpleParserGUIExecuteObject() = default;
 
@@ -46,10 +46,10 @@ SimpleParserGUIExecuteObject* SimpleParserGUIObject::getExecuteObject(
             std::function<ObjectBase*(const ObjectBase::NamedReference&)> resolveReferenceCB
             ) const
 {
-    Q_UNUSED(options)
-    Q_UNUSED(config)
     Q_UNUSED(resolveReferenceCB)
-    return new class SimpleParserGUIExecuteObject(data, getName());
+    SimpleParserGUIExecuteObject* exec = new class SimpleParserGUIExecuteObject(getGrammar(), getName());
+    setupExecuteObject(exec, options, config);
+    return exec;
 }
 
 // ----------------------------------------------------------------------------
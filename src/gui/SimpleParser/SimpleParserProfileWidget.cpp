@@ -0,0 +1,117 @@
+#include "SimpleParserProfileWidget.h"
+
+#include <QVBoxLayout>
+#include <QTabWidget>
+#include <QHeaderView>
+
+namespace {
+QTableWidgetItem* createTextItem(const QString& text)
+{
+    QTableWidgetItem* item = new QTableWidgetItem(text);
+    item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    return item;
+}
+
+// numbers are stored as data so that sorting is numeric
+QTableWidgetItem* createNumberItem(qint64 value)
+{
+    QTableWidgetItem* item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, static_cast<qlonglong>(value));
+    item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    return item;
+}
+
+QTableWidgetItem* createTimeItem(qint64 timeNs)
+{
+    // in microseconds
+    QTableWidgetItem* item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, static_cast<double>(timeNs) / 1000.0);
+    item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    return item;
+}
+} // end of anonymous namespace
+
+SimpleParserProfileWidget::SimpleParserProfileWidget(QWidget* parent)
+    : QWidget(parent),
+      summaryLabel(new QLabel),
+      patternTable(new QTableWidget),
+      boundaryTable(new QTableWidget)
+{
+    patternTable->setColumnCount(7);
+    patternTable->setHorizontalHeaderLabels(QStringList()
+                                            << tr("Rule Node")
+                                            << tr("Pattern")
+                                            << tr("Node Type")
+                                            << tr("Attempts")
+                                            << tr("Successes")
+                                            << tr("Time (us)")
+                                            << tr("Search Entries"));
+    boundaryTable->setColumnCount(5);
+    boundaryTable->setHorizontalHeaderLabels(QStringList()
+                                             << tr("Type")
+                                             << tr("Expression")
+                                             << tr("Searches")
+                                             << tr("Cache Hits")
+                                             << tr("Scanned Characters"));
+    for (QTableWidget* table : {patternTable, boundaryTable}) {
+        table->setSortingEnabled(true);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->verticalHeader()->hide();
+        table->horizontalHeader()->setStretchLastSection(true);
+    }
+
+    QTabWidget* tabs = new QTabWidget;
+    tabs->addTab(patternTable, tr("Patterns"));
+    tabs->addTab(boundaryTable, tr("Boundaries"));
+
+    QVBoxLayout* layout = new QVBoxLayout;
+    layout->addWidget(summaryLabel);
+    layout->addWidget(tabs);
+    setLayout(layout);
+}
+
+void SimpleParserProfileWidget::setReport(const SimpleParser::ProfileReport& report)
+{
+    summaryLabel->setText(tr("%1 parse(s), %2 characters in %3 ms; match cache peak: %4 entries (%5 KiB), %6 evicted")
+                          .arg(QString::number(report.numParses),
+                               QString::number(report.totalParsedChars),
+                               QString::number(static_cast<double>(report.totalParseTimeNs) / 1000000.0),
+                               QString::number(report.cache.peakNumEntries),
+                               QString::number(report.cache.peakEstimatedSize / 1024),
+                               QString::number(report.cache.numEvictedEntries)));
+
+    // sorting must be disabled when populating, otherwise rows are reordered while we write them
+    patternTable->setSortingEnabled(false);
+    patternTable->setRowCount(report.patterns.size());
+    for (int i = 0, n = report.patterns.size(); i < n; ++i) {
+        const auto& record = report.patterns.at(i);
+        patternTable->setItem(i, 0, createTextItem(record.ruleNodeName));
+        patternTable->setItem(i, 1, createNumberItem(record.patternIndex));
+        patternTable->setItem(i, 2, createTextItem(record.typeName));
+        patternTable->setItem(i, 3, createNumberItem(record.numAttempts));
+        patternTable->setItem(i, 4, createNumberItem(record.numSuccesses));
+        patternTable->setItem(i, 5, createTimeItem(record.totalTimeNs));
+        patternTable->setItem(i, 6, createNumberItem(record.numSearchEntries));
+    }
+    patternTable->setSortingEnabled(true);
+
+    boundaryTable->setSortingEnabled(false);
+    boundaryTable->setRowCount(report.boundaries.size());
+    for (int i = 0, n = report.boundaries.size(); i < n; ++i) {
+        const auto& record = report.boundaries.at(i);
+        QString tyStr;
+        switch (record.ty) {
+        case SimpleParser::BoundaryType::StringLiteral: tyStr = tr("String"); break;
+        case SimpleParser::BoundaryType::Regex: tyStr = tr("Regex"); break;
+        case SimpleParser::BoundaryType::SpecialCharacter_WhiteSpaces: tyStr = tr("Whitespaces"); break;
+        case SimpleParser::BoundaryType::SpecialCharacter_OptionalWhiteSpace: tyStr = tr("Optional Whitespaces"); break;
+        default: tyStr = tr("Other"); break;
+        }
+        boundaryTable->setItem(i, 0, createTextItem(tyStr));
+        boundaryTable->setItem(i, 1, createTextItem(TextUtil::sanitizeSingleLineString(record.str)));
+        boundaryTable->setItem(i, 2, createNumberItem(record.numSearches));
+        boundaryTable->setItem(i, 3, createNumberItem(record.numCacheHits));
+        boundaryTable->setItem(i, 4, createNumberItem(record.numScannedChars));
+    }
+    boundaryTable->setSortingEnabled(true);
+}
@@ -0,0 +1,26 @@
+#ifndef SIMPLEPARSERPROFILEWIDGET_H
+#define SIMPLEPARSERPROFILEWIDGET_H
+
+#include "src/lib/Tree/SimpleParser.h"
+
+#include <QWidget>
+#include <QLabel>
+#include <QTableWidget>
+
+// shows SimpleParser::ProfileReport as sortable tables
+class SimpleParserProfileWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit SimpleParserProfileWidget(QWidget* parent = nullptr);
+
+public slots:
+    void setReport(const SimpleParser::ProfileReport& report);
+
+private:
+    QLabel* summaryLabel;
+    QTableWidget* patternTable;
+    QTableWidget* boundaryTable;
+};
+
+#endif // SIMPLEPARSERPROFILEWIDGET_H
@@ -0,0 +1,106 @@
+#include "SimpleParserTestWidget.h"
+
+#include <QVBoxLayout>
+#include <QSplitter>
+#include <QElapsedTimer>
+
+namespace {
+// delay after the last keystroke before the text is parsed
+const int RUN_DELAY_MS = 300;
+} // end of anonymous namespace
+
+SimpleParserTestWidget::SimpleParserTestWidget(QWidget* parent)
+    : QWidget(parent),
+      inputEdit(new TextEditor),
+      outputView(new GeneralTreeEditor),
+      statusLabel(new QLabel),
+      runTimer(new QTimer(this))
+{
+    outputView->setReadOnly(true);
+    statusLabel->setWordWrap(true);
+
+    runTimer->setSingleShot(true);
+    runTimer->setInterval(RUN_DELAY_MS);
+    connect(runTimer, &QTimer::timeout, this, &SimpleParserTestWidget::run);
+    connect(inputEdit, &QPlainTextEdit::textChanged, this, &SimpleParserTestWidget::scheduleRun);
+
+    QSplitter* splitter = new QSplitter(Qt::Vertical);
+    splitter->addWidget(inputEdit);
+    splitter->addWidget(outputView);
+
+    QVBoxLayout* layout = new QVBoxLayout;
+    layout->addWidget(splitter);
+    layout->addWidget(statusLabel);
+    setLayout(layout);
+}
+
+void SimpleParserTestWidget::invalidateGrammar()
+{
+    parser.reset();
+    isLastParseGood = false;
+    if (!inputEdit->document()->isEmpty()) {
+        scheduleRun();
+    }
+}
+
+void SimpleParserTestWidget::scheduleRun()
+{
+    runTimer->start();
+}
+
+void SimpleParserTestWidget::run()
+{
+    if (!parser) {
+        if (!getDataCallback)
+            return;
+        SimpleParser::Data data = getDataCallback();
+        QString err;
+        if (!data.validate(err)) {
+            statusLabel->setText(tr("Invalid grammar: %1").arg(err));
+            return;
+        }
+        parser.reset(new SimpleParser(data));
+        isLastParseGood = false;
+    }
+
+    QString text = inputEdit->toPlainText();
+    Tree tree;
+    QVector<TextUtil::PlainTextLocation> nodeTextRanges;
+    bool isIncremental = isLastParseGood;
+    QElapsedTimer timer;
+    timer.start();
+    bool isGood = false;
+    if (isIncremental) {
+        // the edit is what is left between the common prefix and the common suffix
+        int maxPrefix = qMin(text.length(), lastText.length());
+        int prefix = 0;
+        while (prefix < maxPrefix && text.at(prefix) == lastText.at(prefix)) {
+            prefix += 1;
+        }
+        int maxSuffix = maxPrefix - prefix;
+        int suffix = 0;
+        while (suffix < maxSuffix && text.at(text.length() - 1 - suffix) == lastText.at(lastText.length() - 1 - suffix)) {
+            suffix += 1;
+        }
+        isGood = parser->performIncrementalParsing(text, prefix, lastText.length() - prefix - suffix, text.length() - prefix - suffix,
+                                                   lastTree, lastNodeTextRanges, tree, nodeTextRanges);
+    } else {
+        isGood = parser->performParsing(text, tree, nodeTextRanges);
+    }
+    qint64 elapsedMs = timer.elapsed();
+
+    if (!isGood) {
+        isLastParseGood = false;
+        statusLabel->setText(tr("Parsing failed"));
+        return;
+    }
+    isLastParseGood = true;
+    lastText = text;
+    lastTree.swap(tree);
+    lastNodeTextRanges.swap(nodeTextRanges);
+    outputView->setData(lastTree);
+    statusLabel->setText(tr("%1 node(s) in %2 ms (%3)")
+                         .arg(QString::number(lastTree.getNumNodes()),
+                              QString::number(elapsedMs),
+                              isIncremental? tr("incremental") : tr("full")));
+}
@@ -0,0 +1,49 @@
+#ifndef SIMPLEPARSERTESTWIDGET_H
+#define SIMPLEPARSERTESTWIDGET_H
+
+#include "src/lib/Tree/SimpleParser.h"
+#include "src/gui/TextEditor.h"
+#include "src/gui/GeneralTreeEditor.h"
+
+#include <QWidget>
+#include <QLabel>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+
+// runs the grammar under edit on sample text; edits to the text are reparsed incrementally
+class SimpleParserTestWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit SimpleParserTestWidget(QWidget* parent = nullptr);
+
+    // provides the grammar currently in the editor
+    void setDataCallback(std::function<SimpleParser::Data()> cb) {getDataCallback = cb;}
+
+public slots:
+    // the grammar is changed; the next run builds a new parser and does a full parse
+    void invalidateGrammar();
+    void scheduleRun();
+
+private slots:
+    void run();
+
+private:
+    TextEditor* inputEdit;
+    GeneralTreeEditor* outputView;
+    QLabel* statusLabel;
+    QTimer* runTimer;
+
+    std::function<SimpleParser::Data()> getDataCallback;
+    std::unique_ptr<SimpleParser> parser;
+
+    // result of the last successful parse; used as the base of the next incremental parse
+    bool isLastParseGood = false;
+    QString lastText;
+    Tree lastTree;
+    QVector<TextUtil::PlainTextLocation> lastNodeTextRanges;
+};
+
+#endif // SIMPLEPARSERTESTWIDGET_H
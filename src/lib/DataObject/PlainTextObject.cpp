@@ -1,9 +1,15 @@
 #include "PlainTextObject.h"
 #include "src/gui/PlainTextObjectEditor.h"
 
+#include "src/utils/TextUtilities.h"
+
 #include <QTextStream>
 #include <QTextCodec>
 #include <QMessageBox>
+#include <QFile>
+#include <QScopedPointer>
+
+#include <cstring>
 
 ConfigurationDeclaration PlainTextObject::importConfigDecl;
 
@@ -15,7 +21,52 @@ namespace {
 PlainTextObjectImportSupportDecl importDecl;
 
 const QString CFG_CODEC = QStringLiteral("codec");
-}
+
+// read-only device over a memory-mapped region; unlike QBuffer it is not limited to 2 GiB
+class MappedMemoryDevice : public QIODevice
+{
+public:
+    MappedMemoryDevice(const uchar* dataArg, qint64 sizeArg)
+        : data(dataArg), dataSize(sizeArg)
+    {}
+
+    virtual bool isSequential() const override {return false;}
+    virtual qint64 size() const override {return dataSize;}
+
+protected:
+    virtual qint64 readData(char* dest, qint64 maxSize) override {
+        qint64 len = qMin(maxSize, dataSize - pos());
+        if (len <= 0)
+            return 0;
+        std::memcpy(dest, data + pos(), static_cast<size_t>(len));
+        return len;
+    }
+    virtual qint64 writeData(const char* src, qint64 len) override {
+        Q_UNUSED(src)
+        Q_UNUSED(len)
+        return -1;
+    }
+
+private:
+    const uchar* data;
+    qint64 dataSize;
+};
+} // end of anonymous namespace
+
+struct PlainTextObject::MappedSource {
+    QFile file;
+    const uchar* data = nullptr;
+    qint64 size = 0;
+
+    explicit MappedSource(const QString& filePath)
+        : file(filePath)
+    {}
+    ~MappedSource() {
+        if (data) {
+            file.unmap(const_cast<uchar*>(data));
+        }
+    }
+};
 
 const ConfigurationDeclaration* PlainTextObject::getImportConfigurationDeclaration()
 {
@@ -61,20 +112,76 @@ PlainTextObject* PlainTextObject::open(const QByteArray &src, const Configuratio
     return obj;
 }
 
+PlainTextObject* PlainTextObject::openMapped(const QString& filePath, const ConfigurationData& config)
+{
+    QByteArray codecName = config(CFG_CODEC).toUtf8();
+    QTextCodec* codec = QTextCodec::codecForName(codecName);
+    Q_ASSERT(codec);
+
+    QSharedPointer<MappedSource> src(new MappedSource(filePath));
+    if (!src->file.open(QIODevice::ReadOnly))
+        return nullptr;
+    src->size = src->file.size();
+    if (src->size > 0) {
+        src->data = src->file.map(0, src->size);
+        if (!src->data)
+            return nullptr;
+    }
+
+    // windows are decoded independently of each other later on; make sure there is nothing to replace
+    if (codec->mibEnum() == 106 /* UTF-8 */) {
+        if (!TextUtil::validateUtf8(reinterpret_cast<const char*>(src->data), src->size))
+            return nullptr;
+    }
+
+    PlainTextObject* obj = new PlainTextObject;
+    obj->mapped = src;
+    obj->setImportConfigurationData(config);
+    obj->setExportConfigurationData(config);
+    return obj;
+}
+
+QIODevice* PlainTextObject::createMappedDevice() const
+{
+    Q_ASSERT(mapped);
+    return new MappedMemoryDevice(mapped->data, mapped->size);
+}
+
+QByteArray PlainTextObject::getCodecName() const
+{
+    return getImportConfigurationData()(CFG_CODEC).toUtf8();
+}
+
+QString PlainTextObject::getText() const
+{
+    if (mapped && !isMappedTextDecoded) {
+        // same decoding as open()
+        QScopedPointer<QIODevice> dev(createMappedDevice());
+        dev->open(QIODevice::ReadOnly | QIODevice::Text);
+        QTextStream ts(dev.data());
+        QTextCodec* codec = QTextCodec::codecForName(getCodecName());
+        Q_ASSERT(codec);
+        ts.setCodec(codec);
+        text = ts.readAll();
+        isMappedTextDecoded = true;
+    }
+    return text;
+}
+
 bool PlainTextObject::save(QByteArray& dest) const
 {
     QTextStream ts(&dest, QIODevice::WriteOnly | QIODevice::Text);
     QTextCodec* codec = QTextCodec::codecForName(getExportConfigurationData()(CFG_CODEC).toUtf8());
     Q_ASSERT(codec);
     ts.setCodec(codec);
-    ts << text;
+    ts << getText();
     return true;
 }
 
 QWidget* PlainTextObject::getEditor()
 {
     PlainTextObjectEditor* edit = new PlainTextObjectEditor;
-    edit->getEditor()->setPlainText(text);
+    edit->getEditor()->setPlainText(getText());
     edit->getEditor()->document()->setModified(false);
     edit->clearDirty();
     return edit;
@@ -83,7 +190,7 @@ QWidget* PlainTextObject::getEditor()
 QWidget* PlainTextObject::getViewer()
 {
     TextEditor* viewer = new TextEditor;
-    viewer->setPlainText(text);
+    viewer->setPlainText(getText());
     viewer->document()->setModified(false);
     viewer->setReadOnly(true);
     return viewer;
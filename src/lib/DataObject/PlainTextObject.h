@@ -4,6 +4,8 @@
 #include "src/lib/ImportedObject.h"
 
 #include <QObject>
+#include <QSharedPointer>
+#include <QIODevice>
 
 class PlainTextObject : public ImportedObject
 {
@@ -30,8 +32,17 @@ public:
     virtual QWidget* getEditor() override;
     virtual QWidget* getViewer() override;
 
-    QString getText() const {return text;}
-    void setText(const QString& t) {text = t;}
+    // for memory-mapped objects, the whole text is decoded on the first call
+    QString getText() const;
+    void setText(const QString& t) {text = t; mapped.reset();}
+
+    // memory-mapped input
+    // the file content is only decoded when getText() is called; consumers that can work on a device
+    // (e.g. SimpleParser's streaming parsing) should read through createMappedDevice() instead
+    bool isMapped() const {return !mapped.isNull();}
+    // returns a device reading the mapped file content (still encoded) without copying it; caller takes ownership
+    QIODevice* createMappedDevice() const;
+    QByteArray getCodecName() const;
 
     virtual QString getFileNameFilter() const override;
 
@@ -39,13 +50,24 @@ public:
     static const ConfigurationDeclaration *getImportConfigurationDeclaration();
     static const ConfigurationDeclaration *getExportConfigurationDeclaration();
     static PlainTextObject* open(const QByteArray& src, const ConfigurationData& config);
+    // returns nullptr if the file cannot be mapped or (for UTF-8) is not well-formed
+    static PlainTextObject* openMapped(const QString& filePath, const ConfigurationData& config);
+    static PlainTextObject* openMapped(const QString& filePath) {
+        return openMapped(filePath, defaultConfig);
+    }
+
+    // files at least this large are imported with openMapped()
+    static constexpr qint64 MAPPED_OPEN_THRESHOLD = 64 * 1024 * 1024;
 
 private:
     static ConfigurationDeclaration importConfigDecl;
     static ConfigurationData defaultConfig;
 
 private:
-    QString text;
+    struct MappedSource;
+    mutable QString text;
+    QSharedPointer<MappedSource> mapped; // shared among clones
+    mutable bool isMappedTextDecoded = false;
 };
 
 class PlainTextObjectImportSupportDecl : public FileImportSupportDecl
@@ -65,6 +87,15 @@ protected:
     virtual ImportedObject* import(const QByteArray& data, const ConfigurationData& config) const override {
         return PlainTextObject::open(data, config);
     }
+    // large files are memory-mapped with the codec from config instead of being decoded up front
+    virtual ImportedObject* importFile(const QString& filePath, qint64 fileSize, const QByteArray& data, const ConfigurationData& config) const override {
+        if (!filePath.isEmpty() && fileSize >= PlainTextObject::MAPPED_OPEN_THRESHOLD) {
+            if (PlainTextObject* obj = PlainTextObject::openMapped(filePath, config)) {
+                return obj;
+            }
+        }
+        return FileImportSupportDecl::importFile(filePath, fileSize, data, config);
+    }
 };
 
 #endif // PLAINTEXTOBJECT_H
@@ -1,11 +1,14 @@
 #include "src/lib/FileBackedObject.h"
 #include "src/lib/IntrinsicObject.h"
 #include "src/lib/ImportedObject.h"
+#include "src/lib/DataObject/PlainTextObject.h"
 #include <QFileInfo>
 #include <QByteArray>
 #include <QMessageBox>
 #include <QFileDialog>
 
+#include <limits>
+
 QString FileBackedObject::getFileNameFilter() const {
     return tr("All files (*.*)");
 }
@@ -19,10 +22,28 @@ FileBackedObject* FileBackedObject::open(const QString& filePath, QWidget* windo
                               tr("Failed to open the specified file: %1").arg(filePath));
         return nullptr;
     }
+    QFileInfo file(filePath);
+    qint64 fileSize = f.size();
+
+    // large files are not read up front; the import dialog looks at a mapped view of (the beginning of) the file,
+    // and importers that support it (e.g. plain text) keep the file memory-mapped
+    if (file.suffix() != "xml" && fileSize >= PlainTextObject::MAPPED_OPEN_THRESHOLD) {
+        if (uchar* mappedData = f.map(0, fileSize)) {
+            int viewSize = static_cast<int>(qMin(fileSize, static_cast<qint64>(std::numeric_limits<int>::max())));
+            // the view is only valid until f is closed; importers copy what they keep
+            QByteArray view = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), viewSize);
+            ImportedObject* obj = ImportedObject::open(filePath, fileSize, view, window);
+            if (obj) {
+                obj->setFilePath(filePath);
+                obj->setName(file.completeBaseName());
+            }
+            return obj;
+        }
+    }
+
     QByteArray ba = f.readAll();
     f.close();
 
-    QFileInfo file(filePath);
     if (file.suffix() == "xml") {
         QXmlStreamReader xml(ba);
         if (IntrinsicObject* obj = IntrinsicObject::loadFromXML(xml)) {
@@ -32,7 +53,7 @@ FileBackedObject* FileBackedObject::open(const QString& filePath, QWidget* windo
         }
     }
 
-    ImportedObject* obj = ImportedObject::open(ba, window);
+    ImportedObject* obj = ImportedObject::open(filePath, fileSize, ba, window);
     if (obj) {
         obj->setFilePath(filePath);
         obj->setName(file.completeBaseName());
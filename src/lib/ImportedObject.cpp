@@ -23,9 +23,15 @@ const std::vector<const FileImportSupportDecl*>& FileImportSupportDecl::getInsta
 }
 
 ImportedObject* ImportedObject::open(const QByteArray &src, QWidget* window)
+{
+    return open(QString(), src.size(), src, window);
+}
+
+ImportedObject* ImportedObject::open(const QString& filePath, qint64 fileSize, const QByteArray& src, QWidget* window)
 {
     ImportFileDialog* dialog = new ImportFileDialog(window);
     dialog->setSrc(src);
+    dialog->setSrcFile(filePath, fileSize);
     if (EventLoopHelper::execDialog(dialog) == QDialog::Accepted) {
         return dialog->getResult();
     }
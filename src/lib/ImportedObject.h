@@ -31,6 +31,13 @@ protected:
     virtual bool canOpen(const QByteArray& data, const ConfigurationData& config) const {Q_UNUSED(data) Q_UNUSED(config) return true;}
     virtual const ConfigurationDeclaration* getImportConfigurationDeclaration() const {return nullptr;}
     virtual ImportedObject* import(const QByteArray& data, const ConfigurationData& config) const = 0;
+    // data may only be a view of the beginning of a large file; importers that can read the file directly override this
+    virtual ImportedObject* importFile(const QString& filePath, qint64 fileSize, const QByteArray& data, const ConfigurationData& config) const {
+        Q_UNUSED(filePath)
+        if (fileSize > data.size())
+            return nullptr;
+        return import(data, config);
+    }
 };
 
 // note that while the import part is okay, the export part is not yet
@@ -56,6 +63,8 @@ public:
     virtual void setExportConfigFromImportConfig() {}
 
     static ImportedObject* open(const QByteArray& src, QWidget* window);
+    // src is the content (or a view of the beginning) of the file at filePath
+    static ImportedObject* open(const QString& filePath, qint64 fileSize, const QByteArray& src, QWidget* window);
 
     const ConfigurationData& getImportConfigurationData() const {return importConfig;}
     const ConfigurationData& getExportConfigurationData() const {return exportConfig;}
@@ -22,6 +22,7 @@ public:
         InputAssign_NoStartDialog       = 0x0004, // will fail to execute if not all inputs are specified
         Run_PauseOnStepStart            = 0x0010, // whether there is a breakpoint on start of each execution
         Run_DeleteObjectAfterLastUse    = 0x0020,
+        Run_CollectProfile              = 0x0040, // ExecuteObjects will collect profiling data if supported
         Finalize_AutoTransferObject     = 0x1000, // if editor parent is present, transfer an output object to editor after its last use
         Finalize_AutoCloseIfSuccess     = 0x2000,
         Finalize_AutoCloseIfFail        = 0x4000
@@ -2,6 +2,51 @@
 #include "src/lib/DataObject/PlainTextObject.h"
 #include "src/lib/DataObject/GeneralTreeObject.h"
 
+#include <QScopedPointer>
+#include <QDebug>
+
+#ifdef PP_ENABLE_THREADS
+#include "src/utils/FunctionRunnable.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+#endif
+
+#include <vector>
+
+ConfigurationDeclaration SimpleParserObject::configDecl;
+
+ConfigurationData SimpleParserObject::defaultConfig = {
+{QStringLiteral("batch"), QStringLiteral("false")},
+{QStringLiteral("workers"), QStringLiteral("0")},
+{QStringLiteral("streaming"), QStringLiteral("false")}
+};
+
+namespace {
+const QString CFG_BATCH = QStringLiteral("batch");
+const QString CFG_WORKERS = QStringLiteral("workers");
+const QString CFG_STREAMING = QStringLiteral("streaming");
+const QString CFG_TRUE = QStringLiteral("true");
+const QString CFG_FALSE = QStringLiteral("false");
+
+void appendSubtree(TreeBuilder& builder, TreeBuilder::Node* parent, const Tree& src, int nodeIndex)
+{
+    // pre-order walk over an explicit stack so that deep records do not overflow the call stack
+    // each entry is the source node to copy and the destination parent; children are pushed in reverse order
+    QVector<QPair<int, TreeBuilder::Node*>> stack;
+    stack.push_back(qMakePair(nodeIndex, parent));
+    while (!stack.isEmpty()) {
+        auto entry = stack.takeLast();
+        const Tree::Node& srcNode = src.getNode(entry.first);
+        TreeBuilder::Node* node = builder.addNode(entry.second);
+        node->setDataFromNode(srcNode);
+        for (int i = srcNode.offsetToChildren.size() - 1; i >= 0; --i) {
+            stack.push_back(qMakePair(entry.first + srcNode.offsetToChildren.at(i), node));
+        }
+    }
+}
+} // end of anonymous namespace
+
 SimpleParserObject::SimpleParserObject()
     : TaskObject(ObjectType::Task_SimpleParser)
 {
@@ -14,6 +59,14 @@ SimpleParserObject::SimpleParserObject(const SimpleParser::Data& data)
 
 }
 
+SimpleParserObject::SimpleParserObject(const SimpleParserObject& src)
+    : TaskObject(src), data(src.data)
+{
+    // the lock is not copied; the copy shares the compiled grammar if there is one already
+    QMutexLocker locker(&src.lazyInitLock);
+    grammar = src.grammar;
+}
+
 SimpleParserObject* SimpleParserObject::loadFromXML(QXmlStreamReader& xml, StringCache &strCache)
 {
     SimpleParser::Data data;
@@ -28,6 +81,41 @@ void SimpleParserObject::saveToXMLImpl(QXmlStreamWriter &xml)
     data.saveToXML(xml);
 }
 
+const ConfigurationDeclaration* SimpleParserObject::getConfigurationDeclaration() const
+{
+    if (configDecl.getNumFields() == 0) {
+        QVector<ConfigurationDeclaration::Field> fieldData;
+        fieldData.reserve(3);
+        ConfigurationDeclaration::Field batchField;
+        batchField.ty = ConfigurationDeclaration::FieldType::Boolean;
+        batchField.codeName = CFG_BATCH;
+        batchField.displayName = tr("Parse a batch of documents");
+        batchField.defaultValue = CFG_FALSE;
+        batchField.boolValue_TrueCodeValue = CFG_TRUE;
+        batchField.boolValue_FalseCodeValue = CFG_FALSE;
+        batchField.indexOffsetFromParent = 1;
+        fieldData.push_back(batchField);
+        ConfigurationDeclaration::Field workerField;
+        workerField.ty = ConfigurationDeclaration::FieldType::Integer;
+        workerField.codeName = CFG_WORKERS;
+        workerField.displayName = tr("Number of threads for a batch (0 for one per core)");
+        workerField.defaultValue = QStringLiteral("0");
+        workerField.indexOffsetFromParent = 2;
+        fieldData.push_back(workerField);
+        ConfigurationDeclaration::Field streamingField;
+        streamingField.ty = ConfigurationDeclaration::FieldType::Boolean;
+        streamingField.codeName = CFG_STREAMING;
+        streamingField.displayName = tr("Parse large files record by record (boundaries must be found within the lookahead)");
+        streamingField.defaultValue = CFG_FALSE;
+        streamingField.boolValue_TrueCodeValue = CFG_TRUE;
+        streamingField.boolValue_FalseCodeValue = CFG_FALSE;
+        streamingField.indexOffsetFromParent = 3;
+        fieldData.push_back(streamingField);
+        configDecl = ConfigurationDeclaration(fieldData);
+    }
+    return &configDecl;
+}
+
 TaskObject::PreparationError SimpleParserObject::getInputOutputInfo(
             const ConfigurationData& config,
             QList<TaskInput>& in,
@@ -41,18 +129,18 @@ TaskObject::PreparationError SimpleParserObject::getInputOutputInfo(
     }
 
     // everything good
-    Q_UNUSED(config)
     Q_UNUSED(resolveReferenceCB)
+    bool isBatch = (config.getValueOrDefault(CFG_BATCH, defaultConfig) == CFG_TRUE);
 
     TaskInput textIn;
     textIn.inputName.clear();
-    textIn.flags = InputFlag::NoInputFlag;
+    textIn.flags = isBatch? InputFlag::AcceptBatch : InputFlag::NoInputFlag;
     textIn.acceptedType.push_back(ObjectType::Data_PlainText);
     in.push_back(textIn);
 
     TaskOutput treeOut;
     treeOut.outputName.clear();
-    treeOut.flags = OutputFlag::NoOutputFlag;
+    treeOut.flags = isBatch? OutputFlag::ProduceBatch : OutputFlag::NoOutputFlag;
     treeOut.ty = ObjectType::Data_GeneralTree;
     out.push_back(treeOut);
 
@@ -65,16 +153,35 @@ SimpleParserExecuteObject* SimpleParserObject::getExecuteObject(
             std::function<ObjectBase*(const ObjectBase::NamedReference&)> resolveReferenceCB
             ) const
 {
-    Q_UNUSED(options)
-    Q_UNUSED(config)
     Q_UNUSED(resolveReferenceCB)
-    return new class SimpleParserExecuteObject(data, getName());
+    SimpleParserExecuteObject* exec = new class SimpleParserExecuteObject(getGrammar(), getName());
+    setupExecuteObject(exec, options, config);
+    return exec;
+}
+
+void SimpleParserObject::setupExecuteObject(SimpleParserExecuteObject* exec, const LaunchOptions& options, const ConfigurationData& config) const
+{
+    exec->setBatchMode(config.getValueOrDefault(CFG_BATCH, defaultConfig) == CFG_TRUE);
+    exec->setWorkerCount(qMax(0, config.getValueOrDefault(CFG_WORKERS, defaultConfig).toInt()));
+    exec->setStreamingEnabled(config.getValueOrDefault(CFG_STREAMING, defaultConfig) == CFG_TRUE);
+    if (options.flags & LaunchFlag::Run_CollectProfile) {
+        exec->setProfilingEnabled(true);
+    }
+}
+
+SimpleParser::GrammarPointer SimpleParserObject::getGrammar() const
+{
+    QMutexLocker locker(&lazyInitLock);
+    if (!grammar) {
+        grammar.reset(new SimpleParser::Grammar(data));
+    }
+    return grammar;
 }
 
 //-----------------------------------------------------------------------------
 
-SimpleParserExecuteObject::SimpleParserExecuteObject(const SimpleParser::Data& dataArg, QString name)
-    : ExecuteObject(ObjectType::Exec_SimpleParser, name), parser(dataArg)
+SimpleParserExecuteObject::SimpleParserExecuteObject(const SimpleParser::GrammarPointer& grammar, QString name)
+    : ExecuteObject(ObjectType::Exec_SimpleParser, name), parser(grammar)
 {
 
 }
@@ -85,7 +192,54 @@ void SimpleParserExecuteObject::setInput(QString inputName, ObjectBase* obj)
     Q_ASSERT(inputName.isEmpty());
     PlainTextObject* textObj = qobject_cast<PlainTextObject*>(obj);
     Q_ASSERT(textObj);
-    text = textObj->getText();
+    InputDocument doc;
+    doc.name = textObj->getName();
+    if (textObj->isMapped()) {
+        // the clone shares the mapping
+        doc.mapped.reset(textObj->clone());
+    } else {
+        doc.text = textObj->getText();
+    }
+    if (!isBatchMode) {
+        inputs.clear();
+    }
+    inputs.push_back(doc);
+}
+
+bool SimpleParserExecuteObject::parseDocument(SimpleParser& session, const InputDocument& doc, Tree& dest, const std::function<bool()>& isCancelled) const
+{
+    if (!doc.mapped) {
+        return session.performParsing(doc.text, dest);
+    }
+    if (!isStreamingEnabled) {
+        return session.performParsing(doc.mapped->getText(), dest);
+    }
+
+    // parse record by record from the mapped file so that the whole text is never decoded at once
+    QScopedPointer<QIODevice> dev(doc.mapped->createMappedDevice());
+    if (Q_UNLIKELY(!dev->open(QIODevice::ReadOnly | QIODevice::Text))) {
+        qWarning() << "Failed to open mapped document" << doc.name << dev->errorString();
+        return false;
+    }
+    SimpleParser::StreamingOptions options;
+    options.codecName = doc.mapped->getCodecName();
+    TreeBuilder builder;
+    TreeBuilder::Node* root = builder.addNode(nullptr);
+    bool isFirstRecord = true;
+    bool isGood = session.performStreamingParsing(dev.data(), [&](Tree& record) -> bool {
+        if (isFirstRecord) {
+            root->setDataFromNode(record.getNode(0));
+            isFirstRecord = false;
+        }
+        for (auto offset : record.getNode(0).offsetToChildren) {
+            appendSubtree(builder, root, record, offset);
+        }
+        return !isCancelled();
+    }, options);
+    if (isGood) {
+        dest = Tree(builder);
+    }
+    return isGood;
 }
 
 int SimpleParserExecuteObject::startImpl(ExitCause& cause)
@@ -94,12 +248,103 @@ int SimpleParserExecuteObject::startImpl(ExitCause& cause)
         return -1;
     }
 
+    if (isBatchMode) {
+        return startBatch(cause);
+    }
+
     treeOut = Tree();
-    bool isGood = parser.performParsing(text, treeOut, logger);
+    bool isGood = false;
+    if (!inputs.isEmpty() && inputs.front().mapped && isStreamingEnabled && !logger) {
+        isGood = parseDocument(parser, inputs.front(), treeOut, [&]() -> bool {return isTerminationRequested(cause);});
+    } else {
+        if (!inputs.isEmpty()) {
+            const InputDocument& doc = inputs.front();
+            text = doc.mapped? doc.mapped->getText() : doc.text;
+        }
+        isGood = parser.performParsing(text, treeOut, logger);
+    }
     if (Q_UNLIKELY(!isGood)) {
+        if (isTerminationRequested(cause)) {
+            return -1;
+        }
         return 1;
     }
     GeneralTreeObject* output = new GeneralTreeObject(treeOut);
     emit outputAvailable(QString(), output);
     return 0;
 }
+
+int SimpleParserExecuteObject::startBatch(ExitCause& cause)
+{
+    int numDocuments = inputs.size();
+    std::vector<Tree> results(static_cast<size_t>(numDocuments));
+    std::vector<char> isParsed(static_cast<size_t>(numDocuments), 0);
+    documentFailures.clear();
+
+    int numThreads = 1;
+#ifdef PP_ENABLE_THREADS
+    numThreads = (numWorkers > 0)? numWorkers : QThread::idealThreadCount();
+    numThreads = qBound(1, numThreads, numDocuments);
+#endif
+
+    // with profiling, use the same parser for all documents so that the report covers the whole batch
+    if (numThreads == 1 || parser.isProfilingEnabled()) {
+        auto isCancelled = [&]() -> bool {return isTerminationRequested(cause);};
+        for (int i = 0; i < numDocuments; ++i) {
+            if (isTerminationRequested(cause)) {
+                return -1;
+            }
+            emit statusUpdate(QString(), 0, numDocuments, i);
+            isParsed[i] = parseDocument(parser, inputs.at(i), results[i], isCancelled);
+        }
+    } else {
+#ifdef PP_ENABLE_THREADS
+        // each worker has its own parser on the shared grammar and takes the next document until there is none left
+        QAtomicInt nextIndex(0);
+        QAtomicInt numFinished(0);
+        QAtomicInt isCancelRequested(0);
+        auto work = [&]() -> void {
+            SimpleParser session(parser.getGrammar());
+            session.setMatchCacheOptions(parser.getMatchCacheOptions());
+            session.setPatternEngine(parser.getPatternEngine());
+            auto isCancelled = [&]() -> bool {return isCancelRequested.loadAcquire() != 0;};
+            for (int i = nextIndex.fetchAndAddOrdered(1); i < numDocuments && !isCancelled(); i = nextIndex.fetchAndAddOrdered(1)) {
+                isParsed[i] = parseDocument(session, inputs.at(i), results[i], isCancelled);
+                numFinished.fetchAndAddOrdered(1);
+            }
+        };
+        QThreadPool pool;
+        pool.setMaxThreadCount(numThreads);
+        for (int i = 0; i < numThreads; ++i) {
+            pool.start(new FunctionRunnable(work));
+        }
+        while (!pool.waitForDone(100)) {
+            if (isTerminationRequested(cause)) {
+                isCancelRequested.storeRelease(1);
+            }
+            emit statusUpdate(QString(), 0, numDocuments, numFinished.loadAcquire());
+        }
+        if (isCancelRequested.loadAcquire() != 0) {
+            return -1;
+        }
+#endif
+    }
+
+    // outputs are in input order; failures do not stop other documents and get an empty tree as placeholder
+    for (int i = 0; i < numDocuments; ++i) {
+        if (!isParsed[i]) {
+            DocumentFailure failure;
+            failure.inputIndex = i;
+            failure.inputName = inputs.at(i).name;
+            documentFailures.push_back(failure);
+            qWarning() << "Failed to parse document" << i << failure.inputName;
+            emit outputAvailable(QString(), new GeneralTreeObject);
+            continue;
+        }
+        emit outputAvailable(QString(), new GeneralTreeObject(results[i]));
+    }
+    if (numDocuments > 0 && documentFailures.size() == numDocuments) {
+        return 1;
+    }
+    return 0;
+}
@@ -5,26 +5,79 @@
 #include "src/lib/ExecuteObject.h"
 #include "src/lib/Tree/SimpleParser.h"
 #include "src/lib/Tree/EventLogging.h"
+#include "src/lib/DataObject/PlainTextObject.h"
 
 #include <QObject>
+#include <QSharedPointer>
+#include <QMutex>
+
+#include <functional>
 
 class SimpleParserExecuteObject : public ExecuteObject
 {
     Q_OBJECT
 public:
-    SimpleParserExecuteObject(const SimpleParser::Data& dataArg, QString name);
+    // the grammar is shared with the task object and other execute objects
+    SimpleParserExecuteObject(const SimpleParser::GrammarPointer& grammar, QString name);
     virtual ~SimpleParserExecuteObject() override {}
 
+    const SimpleParser& getParser() const {return parser;}
+
+    void setMatchCacheOptions(const SimpleParser::MatchCacheOptions& options) {parser.setMatchCacheOptions(options);}
+
+    // each input is a document; in batch mode every document is kept and one tree is produced for each of them,
+    // otherwise a new input replaces the previous one
     virtual void setInput(QString inputName, ObjectBase* obj) override;
 
+    void setBatchMode(bool isBatch) {isBatchMode = isBatch;}
+    bool getBatchMode() const {return isBatchMode;}
+
+    // number of threads for parsing a batch; 0 for one per core
+    void setWorkerCount(int count) {numWorkers = count;}
+    int getWorkerCount() const {return numWorkers;}
+
+    // parse memory-mapped documents with streaming parsing instead of decoding the whole text
+    // off by default: the result can differ from a normal parse if a match needs more than the lookahead (see SimpleParser::performStreamingParsing)
+    void setStreamingEnabled(bool enabled) {isStreamingEnabled = enabled;}
+    bool getStreamingEnabled() const {return isStreamingEnabled;}
+
+    struct DocumentFailure {
+        int inputIndex = -1; // in the order of setInput() calls
+        QString inputName; // name of the input object
+    };
+    // documents in the batch that failed to parse; their output is an empty tree so that outputs stay in input order
+    const QVector<DocumentFailure>& getDocumentFailures() const {return documentFailures;}
+
+    void setProfilingEnabled(bool enabled) {parser.setProfilingEnabled(enabled);}
+    bool isProfilingEnabled() const {return parser.isProfilingEnabled();}
+    // only valid after execution; empty if profiling is not enabled
+    const SimpleParser::ProfileReport& getProfileReport() const {return parser.getProfileReport();}
+
 protected:
     virtual int startImpl(ExitCause& cause) override;
 
+    struct InputDocument {
+        QString name;
+        QString text;
+        QSharedPointer<PlainTextObject> mapped; // set instead of text if the input is memory-mapped; decoded unless streaming parsing is used
+    };
+
+    // parse without event logging; memory-mapped documents are parsed with streaming parsing if it is enabled
+    bool parseDocument(SimpleParser& session, const InputDocument& doc, Tree& dest, const std::function<bool()>& isCancelled) const;
+
+    // the logger is not used for batches; failed documents do not stop others and the batch only fails if no document is parsed
+    int startBatch(ExitCause& cause);
+
 protected:
     SimpleParser parser;
-    QString text;
-    Tree treeOut;
+    QVector<InputDocument> inputs;
+    QString text; // text of the document if there is only one
+    Tree treeOut; // tree of the document if there is only one
     EventLogger* logger = nullptr;
+    bool isBatchMode = false;
+    int numWorkers = 0;
+    bool isStreamingEnabled = false;
+    QVector<DocumentFailure> documentFailures;
 };
 
 class SimpleParserObject : public TaskObject
@@ -33,7 +86,7 @@ class SimpleParserObject : public TaskObject
 public:
     explicit SimpleParserObject(const SimpleParser::Data& data);
     SimpleParserObject();
-    SimpleParserObject(const SimpleParserObject&) = default;
+    SimpleParserObject(const SimpleParserObject& src);
     virtual ~SimpleParserObject() override {}
 
     virtual SimpleParserObject* clone() override {
@@ -42,6 +95,9 @@ public:
 
     static SimpleParserObject* loadFromXML(QXmlStreamReader& xml, StringCache &strCache);
 
+    virtual const ConfigurationDeclaration* getConfigurationDeclaration() const override;
+    virtual const ConfigurationData& getDefaultConfig() const override {return defaultConfig;}
+
     virtual PreparationError getInputOutputInfo(
             const ConfigurationData& config,
             QList<TaskInput>& in,
@@ -59,14 +115,28 @@ public:
     }
 
     void setData(const SimpleParser::Data& dataArg) {
+        QMutexLocker locker(&lazyInitLock);
         data = dataArg;
+        grammar.clear();
     }
 
+    // compiled on first use and shared by all execute objects afterwards
+    // safe to call from multiple threads
+    SimpleParser::GrammarPointer getGrammar() const;
+
 protected:
     virtual void saveToXMLImpl(QXmlStreamWriter &xml) override;
 
+    // applies configuration and launch options shared by all execute object types
+    void setupExecuteObject(SimpleParserExecuteObject* exec, const LaunchOptions& options, const ConfigurationData& config) const;
+
 protected:
     SimpleParser::Data data;
+    mutable QMutex lazyInitLock; // guards grammar; execute objects can be created from different threads
+    mutable SimpleParser::GrammarPointer grammar; // lazily compiled from data
+
+    static ConfigurationDeclaration configDecl;
+    static ConfigurationData defaultConfig;
 };
 
 #endif // SIMPLEPARSEROBJECT_H
@@ -1,14 +1,110 @@
 #include "SimpleTreeTransformObject.h"
 #include "src/lib/DataObject/GeneralTreeObject.h"
+#include <QDebug>
+#include <QMutexLocker>
+
+ConfigurationDeclaration SimpleTreeTransformObject::configDecl;
+
+ConfigurationData SimpleTreeTransformObject::defaultConfig = {
+{QStringLiteral("parallelDepth"), QStringLiteral("0")},
+{QStringLiteral("workers"), QStringLiteral("0")},
+{QStringLiteral("errors"), QStringLiteral("All")},
+{QStringLiteral("profile"), QStringLiteral("false")}
+};
+
+namespace {
+const QString CFG_PARALLEL_DEPTH = QStringLiteral("parallelDepth");
+const QString CFG_WORKERS = QStringLiteral("workers");
+const QString CFG_ERRORS = QStringLiteral("errors");
+const QString CFG_ERRORS_ALL = QStringLiteral("All");
+const QString CFG_ERRORS_FIRST = QStringLiteral("First");
+const QString CFG_ERRORS_CODE = QStringLiteral("Code");
+const QString CFG_PROFILE = QStringLiteral("profile");
+const QString CFG_TRUE = QStringLiteral("true");
+const QString CFG_FALSE = QStringLiteral("false");
+
+const QString OUTPUT_PROFILE = QStringLiteral("Profile");
+
+// errors beyond this are only counted in the log
+const int MAX_REPORTED_ERRORS = 10;
+
+const QString PROFILE_ROOT = QStringLiteral("TransformProfile");
+const QString PROFILE_NODE_TYPE = QStringLiteral("NodeType");
+const QString PROFILE_RULE = QStringLiteral("Rule");
+
+// profile as a tree: root -> node types -> rules, with counters as key value pairs
+Tree getProfileTree(SimpleTreeTransform::TransformProfile& profile)
+{
+    QMutexLocker locker(&profile.mutex);
+    PreOrderTreeBuilder builder;
+    int root = builder.addNode(-1);
+    QStringList nodeTypes = profile.rules.keys();
+    nodeTypes.sort();
+    int numDeadRules = 0;
+    for (const QString& ty : nodeTypes) {
+        int typeNode = builder.addNode(root);
+        Tree::Node& typeData = builder.getNode(typeNode);
+        typeData.typeName = PROFILE_NODE_TYPE;
+        typeData.keyList << QStringLiteral("Type");
+        typeData.valueList << ty;
+        const auto& entries = profile.rules.value(ty);
+        for (int i = 0, n = entries.size(); i < n; ++i) {
+            const auto& entry = entries.at(i);
+            QStringList failures;
+            for (qint64 count : entry.numPredicateFailures) {
+                failures.push_back(QString::number(count));
+            }
+            // a rule that never matched is either dead or not covered by the inputs so far
+            bool isDead = (entry.numMatched == 0);
+            if (isDead) {
+                numDeadRules += 1;
+            }
+            Tree::Node& ruleData = builder.getNode(builder.addNode(typeNode));
+            ruleData.typeName = PROFILE_RULE;
+            ruleData.keyList << QStringLiteral("Index")
+                             << QStringLiteral("Evaluated")
+                             << QStringLiteral("Matched")
+                             << QStringLiteral("PredicateFailures")
+                             << QStringLiteral("PredicateTimeNs")
+                             << QStringLiteral("TemplateTimeNs")
+                             << QStringLiteral("Dead");
+            ruleData.valueList << QString::number(i)
+                               << QString::number(entry.numEvaluated)
+                               << QString::number(entry.numMatched)
+                               << failures.join(',')
+                               << QString::number(entry.predicateTimeNs)
+                               << QString::number(entry.templateTimeNs)
+                               << (isDead? CFG_TRUE : CFG_FALSE);
+        }
+    }
+    Tree::Node& rootData = builder.getNode(root);
+    rootData.typeName = PROFILE_ROOT;
+    rootData.keyList << QStringLiteral("DefaultAction")
+                     << QStringLiteral("UnrecognizedNodeAction")
+                     << QStringLiteral("Skipped")
+                     << QStringLiteral("DeadRules");
+    rootData.valueList << QString::number(profile.numDefaultAction)
+                       << QString::number(profile.numUnrecognizedAction)
+                       << QString::number(profile.numSkipped)
+                       << QString::number(numDeadRules);
+    Tree result;
+    builder.takeTree(result);
+    return result;
+}
+} // end of anonymous namespace
 
 SimpleTreeTransformObject::SimpleTreeTransformObject()
-    : TaskObject(ObjectType::Task_SimpleTreeTransform)
+    : TaskObject(ObjectType::Task_SimpleTreeTransform),
+      predicateStats(new SimpleTreeTransform::PredicateStatistics),
+      profile(new SimpleTreeTransform::TransformProfile)
 {
 
 }
 
 SimpleTreeTransformObject::SimpleTreeTransformObject(const SimpleTreeTransform::Data& dataArg)
-    : TaskObject(ObjectType::Task_SimpleTreeTransform), data(dataArg)
+    : TaskObject(ObjectType::Task_SimpleTreeTransform), data(dataArg),
+      predicateStats(new SimpleTreeTransform::PredicateStatistics),
+      profile(new SimpleTreeTransform::TransformProfile)
 {
 
 }
@@ -27,13 +123,54 @@ SimpleTreeTransformObject* SimpleTreeTransformObject::loadFromXML(QXmlStreamRead
     return nullptr;
 }
 
+const ConfigurationDeclaration* SimpleTreeTransformObject::getConfigurationDeclaration() const
+{
+    if (configDecl.getNumFields() == 0) {
+        QVector<ConfigurationDeclaration::Field> fieldData;
+        fieldData.reserve(4);
+        ConfigurationDeclaration::Field depthField;
+        depthField.ty = ConfigurationDeclaration::FieldType::Integer;
+        depthField.codeName = CFG_PARALLEL_DEPTH;
+        depthField.displayName = tr("Depth of subtrees to transform in parallel (0 to disable)");
+        depthField.defaultValue = QStringLiteral("0");
+        depthField.indexOffsetFromParent = 1;
+        fieldData.push_back(depthField);
+        ConfigurationDeclaration::Field workerField;
+        workerField.ty = ConfigurationDeclaration::FieldType::Integer;
+        workerField.codeName = CFG_WORKERS;
+        workerField.displayName = tr("Number of threads (0 for one per core)");
+        workerField.defaultValue = QStringLiteral("0");
+        workerField.indexOffsetFromParent = 2;
+        fieldData.push_back(workerField);
+        ConfigurationDeclaration::Field errorField;
+        errorField.ty = ConfigurationDeclaration::FieldType::Enum;
+        errorField.codeName = CFG_ERRORS;
+        errorField.displayName = tr("Errors to report");
+        errorField.defaultValue = CFG_ERRORS_ALL;
+        errorField.enumValue_CodeValueList << CFG_ERRORS_ALL << CFG_ERRORS_FIRST << CFG_ERRORS_CODE;
+        errorField.enumValue_DisplayValueList << tr("All, with details") << tr("First only") << tr("All, without details");
+        errorField.indexOffsetFromParent = 3;
+        fieldData.push_back(errorField);
+        ConfigurationDeclaration::Field profileField;
+        profileField.ty = ConfigurationDeclaration::FieldType::Boolean;
+        profileField.codeName = CFG_PROFILE;
+        profileField.displayName = tr("Output rule profile");
+        profileField.defaultValue = CFG_FALSE;
+        profileField.boolValue_TrueCodeValue = CFG_TRUE;
+        profileField.boolValue_FalseCodeValue = CFG_FALSE;
+        profileField.indexOffsetFromParent = 4;
+        fieldData.push_back(profileField);
+        configDecl = ConfigurationDeclaration(fieldData);
+    }
+    return &configDecl;
+}
+
 TaskObject::PreparationError SimpleTreeTransformObject::getInputOutputInfo(
             const ConfigurationData& config,
             QList<TaskInput>& in,
             QList<TaskOutput>& out,
             std::function<ObjectBase*(const ObjectBase::NamedReference&)> resolveReferenceCB) const
 {
-    Q_UNUSED(config)
     Q_UNUSED(resolveReferenceCB)
 
     TaskInput treeIn;
@@ -55,6 +192,14 @@ TaskObject::PreparationError SimpleTreeTransformObject::getInputOutputInfo(
     treeOut.ty = ObjectType::Data_GeneralTree;
     out.push_back(treeOut);
 
+    if (config.getValueOrDefault(CFG_PROFILE, defaultConfig) == CFG_TRUE) {
+        TaskOutput profileOut;
+        profileOut.outputName = OUTPUT_PROFILE;
+        profileOut.flags = OutputFlag::TemporaryOutput;
+        profileOut.ty = ObjectType::Data_GeneralTree;
+        out.push_back(profileOut);
+    }
+
     return PreparationError();
 }
 
@@ -65,9 +210,25 @@ SimpleTreeTransformExecuteObject* SimpleTreeTransformObject::getExecuteObject(
     ) const
 {
     Q_UNUSED(options)
-    Q_UNUSED(config)
     Q_UNUSED(resolveReferenceCB)
-    return new class SimpleTreeTransformExecuteObject(data, getName());
+    SimpleTreeTransformExecuteObject* exec = new class SimpleTreeTransformExecuteObject(data, getName());
+    SimpleTreeTransform::ParallelOptions parallelOptions;
+    parallelOptions.partitionDepth = qMax(0, config.getValueOrDefault(CFG_PARALLEL_DEPTH, defaultConfig).toInt());
+    parallelOptions.numWorkers = qMax(0, config.getValueOrDefault(CFG_WORKERS, defaultConfig).toInt());
+    exec->setParallelOptions(parallelOptions);
+    SimpleTreeTransform::TransformOptions transformOptions;
+    QString errorRecording = config.getValueOrDefault(CFG_ERRORS, defaultConfig);
+    if (errorRecording == CFG_ERRORS_FIRST) {
+        transformOptions.errorRecording = SimpleTreeTransform::TransformOptions::ErrorRecording::FirstOnly;
+    } else if (errorRecording == CFG_ERRORS_CODE) {
+        transformOptions.errorRecording = SimpleTreeTransform::TransformOptions::ErrorRecording::CodeOnly;
+    }
+    exec->setTransformOptions(transformOptions);
+    exec->setPredicateStatistics(predicateStats);
+    if (config.getValueOrDefault(CFG_PROFILE, defaultConfig) == CFG_TRUE) {
+        exec->setProfile(profile);
+    }
+    return exec;
 }
 
 //-----------------------------------------------------------------------------
@@ -106,13 +267,37 @@ int SimpleTreeTransformExecuteObject::startImpl(ExitCause& cause)
 
     Tree treeOut;
     SimpleTreeTransform transform(data);
+    transform.setParallelOptions(parallelOptions);
+    transform.setTransformOptions(transformOptions);
+    transform.setPredicateStatistics(predicateStats);
+    transform.setProfile(profile);
     QList<const Tree*> sideTreePtrList;
     for (int i = 0, n = sideTreeList.size(); i < n; ++i) {
         sideTreePtrList.push_back(&sideTreeList.at(i));
     }
-    bool transformGood = transform.performTransform(treeIn, treeOut, sideTreePtrList);
-    Q_ASSERT(transformGood);
+    // provenance is not used here, so it is not collected
+    errors.clear();
+    bool transformGood = transform.performTransform(treeIn, treeOut, sideTreePtrList, nullptr, &errors);
+    if (!transformGood) {
+        // FirstOnly recording keeps a single error; the other modes keep all of them
+        int numReported = qMin(errors.size(), MAX_REPORTED_ERRORS);
+        qWarning() << "Transform failed with" << errors.size() << "recorded error(s)";
+        for (int i = 0; i < numReported; ++i) {
+            const auto& err = errors.at(i);
+            qWarning() << "Transform error at node" << err.srcNodeIndex << "pattern" << err.patternIndex
+                       << "cause" << SimpleTreeTransform::TransformError::getCauseName(err.cause)
+                       << err.unrecognizedNodeType;
+        }
+        if (errors.size() > numReported) {
+            qWarning() << "..." << (errors.size() - numReported) << "more error(s) not shown";
+        }
+        emit statusUpdate(tr("Transform failed with %1 error(s)").arg(errors.size()), 0, 1, 1);
+    }
+    // the output tree is still built when there are errors, so it is emitted for inspection
     GeneralTreeObject* output = new GeneralTreeObject(treeOut);
     emit outputAvailable(QString(), output);
-    return 0;
+    if (profile) {
+        emit outputAvailable(OUTPUT_PROFILE, new GeneralTreeObject(getProfileTree(*profile)));
+    }
+    return transformGood? 0 : 1;
 }
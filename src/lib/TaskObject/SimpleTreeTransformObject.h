@@ -17,13 +17,26 @@ public:
 
     virtual void setInput(QString inputName, ObjectBase* obj) override;
 
+    void setParallelOptions(const SimpleTreeTransform::ParallelOptions& options) {parallelOptions = options;}
+    void setTransformOptions(const SimpleTreeTransform::TransformOptions& options) {transformOptions = options;}
+    void setPredicateStatistics(const SimpleTreeTransform::PredicateStatisticsPointer& stats) {predicateStats = stats;}
+    // null to disable profiling; otherwise the profile (including previous runs) is emitted as the "Profile" output
+    void setProfile(const SimpleTreeTransform::TransformProfilePointer& profileArg) {profile = profileArg;}
+    // errors of the last run, as recorded by the transform options; the run fails (exit code 1) if there is any
+    const QVector<SimpleTreeTransform::TransformError>& getErrors() const {return errors;}
+
 protected:
     virtual int startImpl(ExitCause& cause) override;
 
 private:
     SimpleTreeTransform::Data data;
+    SimpleTreeTransform::ParallelOptions parallelOptions;
+    SimpleTreeTransform::TransformOptions transformOptions;
+    SimpleTreeTransform::PredicateStatisticsPointer predicateStats;
+    SimpleTreeTransform::TransformProfilePointer profile;
     Tree treeIn;
     QList<Tree> sideTreeList;
+    QVector<SimpleTreeTransform::TransformError> errors;
 };
 
 class SimpleTreeTransformObject : public TaskObject
@@ -41,6 +54,9 @@ public:
 
     static SimpleTreeTransformObject* loadFromXML(QXmlStreamReader& xml, StringCache &strCache);
 
+    virtual const ConfigurationDeclaration* getConfigurationDeclaration() const override;
+    virtual const ConfigurationData& getDefaultConfig() const override {return defaultConfig;}
+
     virtual PreparationError getInputOutputInfo(
             const ConfigurationData& config,
             QList<TaskInput>& in,
@@ -58,6 +74,13 @@ protected:
 
 private:
     SimpleTreeTransform::Data data;
+    // collected from previous runs (shared with clones) to order rule predicates in later runs
+    SimpleTreeTransform::PredicateStatisticsPointer predicateStats;
+    // accumulated over all profiled runs (shared with clones), so that rules never matched on a corpus are found
+    SimpleTreeTransform::TransformProfilePointer profile;
+
+    static ConfigurationDeclaration configDecl;
+    static ConfigurationData defaultConfig;
 };
 
 #endif // SIMPLETREETRANSFORMOBJECT_H
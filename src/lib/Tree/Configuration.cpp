@@ -77,6 +77,18 @@ QString ConfigurationData::Visitor::operator()(const QString& codeName) const
     return QString();
 }
 
+QString ConfigurationData::getValueOrDefault(const QString& codeName, const ConfigurationData& defaultConfig) const
+{
+    QString value;
+    if (!isEmpty()) {
+        value = (*this)(codeName);
+    }
+    if (value.isEmpty()) {
+        value = defaultConfig(codeName);
+    }
+    return value;
+}
+
 bool ConfigurationData::isValid(const ConfigurationDeclaration& decl) const
 {
 #pragma message ( "ConfigurationData::isValid() is not implemented yet." )
@@ -66,6 +66,10 @@ public:
     ConfigurationData(std::initializer_list<std::pair<QString, QString>> list);
     bool isValid(const ConfigurationDeclaration& decl) const;
 
+    // the value from defaultConfig if codeName is not set here
+    // (configurations from before a field was added are empty or do not have it)
+    QString getValueOrDefault(const QString& codeName, const ConfigurationData& defaultConfig) const;
+
 public:
     class Visitor {
     public:
@@ -1,9 +1,28 @@
 #include "SimpleParser.h"
 #include "src/lib/Tree/Tree.h"
 
+#include <QTextStream>
+#include <QTextCodec>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSet>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
 // ----------------------------------------------------------------------------
 // Parser implementation
 
+namespace {
+QRegularExpression compileRegex(const QString& pattern)
+{
+    QRegularExpression regex(pattern, QRegularExpression::MultilineOption | QRegularExpression::DontCaptureOption | QRegularExpression::UseUnicodePropertiesOption);
+    Q_ASSERT(regex.isValid());
+    return regex;
+}
+} // end of anonymous namespace
+
 QString SimpleParser::getWhiteSpaceRegexPattern(const QStringList& whiteSpaceList)
 {
     Q_ASSERT(!whiteSpaceList.isEmpty());
@@ -83,15 +102,48 @@ QString SimpleParser::getWhiteSpaceRegexPattern(const QStringList& whiteSpaceLis
 }
 
 SimpleParser::SimpleParser(const Data& d)
+    : grammar(new Grammar(d))
+{
+    initializeState();
+}
+
+SimpleParser::SimpleParser(const GrammarPointer& grammarArg)
+    : grammar(grammarArg)
+{
+    Q_ASSERT(grammar);
+    initializeState();
+}
+
+void SimpleParser::initializeState()
+{
+    // the compiled regexes are implicitly shared with the grammar
+    state.regexList = grammar->regexList;
+    state.regexPatternToIndexMap = grammar->regexPatternToIndexMap;
+    state.isRegexCaptureStored = grammar->isRegexCaptureStored;
+    int numRegexes = state.regexList.size();
+    state.regexMatchPositionMap.reserve(numRegexes);
+    for (int i = 0; i < numRegexes; ++i) {
+        state.regexMatchPositionMap.push_back(QMap<int, std::pair<int, ParseState::RegexMatchData>>());
+    }
+    state.regexLastUse.fill(0, numRegexes);
+    state.classBasedSearchMemo.fill(std::make_pair(-1, -1), grammar->data.namedBoundaries.size());
+}
+
+SimpleParser::Grammar::Grammar(const Data& d)
     : data(d)
 {
+    compile();
+    prepareRegexes();
+}
+
+void SimpleParser::Grammar::compile()
+{
+    const Data& d = data;
     // TODO no handling for generalParanthesis yet
 
-    // use whitespaceList to form regular expression for white space related search
-    QString basePattern = getWhiteSpaceRegexPattern(d.whitespaceList);
-    regexIndex_SpecialCharacter_OptionalWhiteSpace = state.getRegexIndex(basePattern + '*');
-    regexIndex_SpecialCharacter_WhiteSpaces = state.getRegexIndex(basePattern + '+');
-    emptyLineRegex = QRegularExpression("^(" + basePattern + "*\n)+");
+    // use whitespaceList to build the classifier for white space related search
+    Q_ASSERT(!d.whitespaceList.isEmpty());
+    whitespaceClassifier.build(d.whitespaceList);
 
     // build the boundary name mapping
     for (int i = 0, n = d.namedBoundaries.size(); i < n; ++i) {
@@ -180,14 +232,574 @@ SimpleParser::SimpleParser(const Data& d)
         }
         populateChildNodeMatchRules(d.matchRuleNodes.size(), topNodes);
     }
+
+    // literal prefixes of patterns
+    literalPatternInfo.resize(d.matchRuleNodes.size());
+    for (int i = 0, n = d.matchRuleNodes.size(); i < n; ++i) {
+        const auto& patterns = d.matchRuleNodes.at(i).patterns;
+        auto& infoVec = literalPatternInfo[i];
+        infoVec.reserve(patterns.size());
+        for (const auto& pattern : patterns) {
+            LiteralPatternInfo info;
+            const auto& elements = pattern.pattern;
+            for (const auto& pe : elements) {
+                if (pe.ty == PatternElement::ElementType::AnonymousBoundary_StringLiteral) {
+                    info.prefix.append(pe.str);
+                } else if (pe.ty == PatternElement::ElementType::AnonymousBoundary_SpecialCharacter_LineFeed) {
+                    info.prefix.append('\n');
+                } else {
+                    break;
+                }
+                info.numPrefixElements += 1;
+            }
+            int numElements = elements.size();
+            if (info.numPrefixElements > 0) {
+                info.isLiteralOnly = (info.numPrefixElements == numElements)
+                        || (info.numPrefixElements + 1 == numElements && elements.back().ty == PatternElement::ElementType::Content);
+            }
+            infoVec.push_back(info);
+        }
+    }
+    buildPrefixTries();
+    buildClassBasedMatchers();
+
+    // regular expressions used anywhere in the grammar
+    auto addRegexPattern = [this](const QString& pattern) -> void {
+        if (!grammarRegexPatterns.contains(pattern)) {
+            grammarRegexPatterns.push_back(pattern);
+        }
+    };
+    for (const auto& b : d.namedBoundaries) {
+        for (const auto& decl : b.elements) {
+            if (decl.decl == BoundaryDeclaration::DeclarationType::Value && decl.ty == BoundaryType::Regex) {
+                addRegexPattern(decl.str);
+            }
+        }
+    }
+    for (const auto& rule : d.matchRuleNodes) {
+        for (const auto& pattern : rule.patterns) {
+            for (const auto& pe : pattern.pattern) {
+                if (pe.ty == PatternElement::ElementType::AnonymousBoundary_Regex) {
+                    addRegexPattern(pe.str);
+                }
+            }
+        }
+    }
+}
+
+void SimpleParser::Grammar::buildPrefixTries()
+{
+    for (auto& rulesData : childNodeMatchRules) {
+        for (auto& passData : rulesData) {
+            int ordinal = 0;
+            for (auto iter = passData.patterns.cbegin(), iterEnd = passData.patterns.cend(); iter != iterEnd; ++iter) {
+                for (int patternIndex : iter.value()) {
+                    passData.prefixTrie.addPrefix(literalPatternInfo.at(iter.key()).at(patternIndex).prefix, ordinal++);
+                }
+            }
+            passData.prefixTrie.numPatterns = ordinal;
+        }
+    }
 }
 
+void SimpleParser::Grammar::buildClassBasedMatchers()
+{
+    for (auto iter = classBasedBoundaryChildList.cbegin(), iterEnd = classBasedBoundaryChildList.cend(); iter != iterEnd; ++iter) {
+        ClassBasedMatcher matcher;
+        QSet<int> visitedBoundaries;
+        QSet<QString> literals;
+        std::function<void(int)> addBoundary;
+        addBoundary = [&](int boundaryIndex) -> void {
+            if (visitedBoundaries.contains(boundaryIndex))
+                return;
+            visitedBoundaries.insert(boundaryIndex);
+            for (const auto& decl : data.namedBoundaries.at(boundaryIndex).elements) {
+                if (decl.decl == BoundaryDeclaration::DeclarationType::NameReference) {
+                    int referencedIndex = boundaryNameToIndexMap.value(decl.str, -1);
+                    if (classBasedBoundaryChildList.contains(referencedIndex)) {
+                        addBoundary(referencedIndex);
+                        continue;
+                    }
+                } else if (decl.ty == BoundaryType::StringLiteral || decl.ty == BoundaryType::SpecialCharacter_LineFeed) {
+                    QString str = (decl.ty == BoundaryType::StringLiteral)? decl.str : QStringLiteral("\n");
+                    if (!literals.contains(str)) {
+                        literals.insert(str);
+                        matcher.literals.addPrefix(str, matcher.literals.numPatterns++);
+                    }
+                    continue;
+                }
+                matcher.otherElements.push_back(decl);
+            }
+            for (int child : classBasedBoundaryChildList.value(boundaryIndex)) {
+                addBoundary(child);
+            }
+        };
+        addBoundary(iter.key());
+        classBasedMatchers.insert(iter.key(), matcher);
+    }
+}
+
+void SimpleParser::Grammar::prepareRegexes()
+{
+    // compile (and JIT) all regular expressions now instead of on first use
+    for (const auto& pattern : qAsConst(grammarRegexPatterns)) {
+        QRegularExpression regex = compileRegex(pattern);
+        regex.optimize();
+        regexPatternToIndexMap.insert(pattern, regexList.size());
+        regexList.push_back(regex);
+        isRegexCaptureStored.push_back(false);
+    }
+
+    // only regexes in patterns with an exported element need to keep their captures
+    for (const auto& rule : data.matchRuleNodes) {
+        for (const auto& pattern : rule.patterns) {
+            for (const auto& pe : pattern.pattern) {
+                if (pe.ty == PatternElement::ElementType::AnonymousBoundary_Regex && !pe.elementName.isEmpty()) {
+                    isRegexCaptureStored[regexPatternToIndexMap.value(pe.str)] = true;
+                }
+            }
+        }
+    }
+}
+
+void SimpleParser::LiteralPrefixTrie::addPrefix(const QString& prefix, int ordinal)
+{
+    if (nodes.isEmpty()) {
+        nodes.push_back(Node());
+    }
+    int cur = 0;
+    for (QChar c : prefix) {
+        auto& edges = nodes[cur].edges;
+        auto iter = std::lower_bound(edges.begin(), edges.end(), c, [](const std::pair<QChar, int>& edge, QChar value) -> bool {
+            return edge.first < value;
+        });
+        if (iter != edges.end() && iter->first == c) {
+            cur = iter->second;
+        } else {
+            int next = nodes.size();
+            edges.insert(iter, std::make_pair(c, next));
+            nodes.push_back(Node());
+            cur = next;
+        }
+    }
+    nodes[cur].terminals.push_back(ordinal);
+}
+
+void SimpleParser::LiteralPrefixTrie::match(const QString& text, int pos, std::vector<char>& isCandidate) const
+{
+    isCandidate.assign(numPatterns, 0);
+    if (nodes.isEmpty())
+        return;
+    int cur = 0;
+    int textLength = text.length();
+    while (true) {
+        const Node& node = nodes.at(cur);
+        for (int ordinal : node.terminals) {
+            isCandidate[ordinal] = 1;
+        }
+        if (pos >= textLength || node.edges.isEmpty())
+            break;
+        QChar c = text.at(pos);
+        auto iter = std::lower_bound(node.edges.begin(), node.edges.end(), c, [](const std::pair<QChar, int>& edge, QChar value) -> bool {
+            return edge.first < value;
+        });
+        if (iter == node.edges.end() || iter->first != c)
+            break;
+        cur = iter->second;
+        pos += 1;
+    }
+}
+
+int SimpleParser::LiteralPrefixTrie::matchLongest(const QChar* text, int pos, int end) const
+{
+    if (nodes.isEmpty())
+        return -1;
+    int result = -1;
+    int cur = 0;
+    for (int i = pos; ; ++i) {
+        const Node& node = nodes.at(cur);
+        if (!node.terminals.isEmpty()) {
+            result = i - pos;
+        }
+        if (i >= end || node.edges.isEmpty())
+            break;
+        QChar c = text[i];
+        auto iter = std::lower_bound(node.edges.begin(), node.edges.end(), c, [](const std::pair<QChar, int>& edge, QChar value) -> bool {
+            return edge.first < value;
+        });
+        if (iter == node.edges.end() || iter->first != c)
+            break;
+        cur = iter->second;
+    }
+    return result;
+}
+
+void SimpleParser::WhiteSpaceClassifier::addToTrie(QVector<TrieNode>& nodes, const QString& str, bool isReversed)
+{
+    int cur = 0;
+    for (int i = 0, n = str.length(); i < n; ++i) {
+        QChar c = str.at(isReversed? (n - 1 - i) : i);
+        auto& edges = nodes[cur].edges;
+        auto iter = std::lower_bound(edges.begin(), edges.end(), c, [](const std::pair<QChar, int>& edge, QChar value) -> bool {
+            return edge.first < value;
+        });
+        if (iter != edges.end() && iter->first == c) {
+            cur = iter->second;
+        } else {
+            int next = nodes.size();
+            edges.insert(iter, std::make_pair(c, next));
+            nodes.push_back(TrieNode());
+            cur = next;
+        }
+    }
+    nodes[cur].isTerminal = true;
+}
+
+int SimpleParser::WhiteSpaceClassifier::walkTrie(const QVector<TrieNode>& nodes, const QChar* str, int pos, int limit, int step)
+{
+    int cur = 0;
+    int depth = 0;
+    int bestLength = 0;
+    while (pos != limit) {
+        const auto& edges = nodes.at(cur).edges;
+        QChar c = str[pos];
+        auto iter = std::lower_bound(edges.begin(), edges.end(), c, [](const std::pair<QChar, int>& edge, QChar value) -> bool {
+            return edge.first < value;
+        });
+        if (iter == edges.end() || iter->first != c)
+            break;
+        cur = iter->second;
+        depth += 1;
+        pos += step;
+        if (nodes.at(cur).isTerminal) {
+            bestLength = depth;
+        }
+    }
+    return bestLength;
+}
+
+void SimpleParser::WhiteSpaceClassifier::build(const QStringList& whitespaceList)
+{
+    singleUnitBitmap.assign(65536 / 32, 0);
+    forwardTrie.clear();
+    backwardTrie.clear();
+    forwardTrie.push_back(TrieNode());
+    backwardTrie.push_back(TrieNode());
+    for (const auto& ws : whitespaceList) {
+        if (ws.length() == 1) {
+            ushort u = ws.at(0).unicode();
+            singleUnitBitmap[u >> 5] |= (1u << (u & 31));
+        } else if (ws.length() > 1) {
+            addToTrie(forwardTrie, ws, false);
+            addToTrie(backwardTrie, ws, true);
+        }
+    }
+}
+
+int SimpleParser::WhiteSpaceClassifier::matchForward(const QChar* str, int pos, int end) const
+{
+    if (pos >= end)
+        return 0;
+    int len = walkTrie(forwardTrie, str, pos, end, 1);
+    if (len == 0 && isSingleUnitWhiteSpace(str[pos])) {
+        len = 1;
+    }
+    return len;
+}
+
+int SimpleParser::WhiteSpaceClassifier::matchBackward(const QChar* str, int start, int end) const
+{
+    if (end <= start)
+        return 0;
+    int len = walkTrie(backwardTrie, str, end - 1, start - 1, -1);
+    if (len == 0 && isSingleUnitWhiteSpace(str[end - 1])) {
+        len = 1;
+    }
+    return len;
+}
+
+int SimpleParser::WhiteSpaceClassifier::runLength(const QChar* str, int pos, int end) const
+{
+    int cur = pos;
+    while (cur < end) {
+        int len = matchForward(str, cur, end);
+        if (len == 0)
+            break;
+        cur += len;
+    }
+    return cur - pos;
+}
+
+int SimpleParser::WhiteSpaceClassifier::findNext(const QChar* str, int pos, int end) const
+{
+    bool hasMultiUnitEntry = !forwardTrie.front().edges.isEmpty();
+    for (int cur = pos; cur < end; ++cur) {
+        if (isSingleUnitWhiteSpace(str[cur]))
+            return cur;
+        if (hasMultiUnitEntry && walkTrie(forwardTrie, str, cur, end, 1) > 0)
+            return cur;
+    }
+    return -1;
+}
+
+// bookkeeping for parsing only part of the text (streaming and incremental parsing)
+struct SimpleParser::PartialParseState {
+    std::function<bool(Tree&)>* recordCallback = nullptr; // null if records are kept in the tree
+    std::function<bool(int, int, const TreeBuilder::Node*)> resyncCheck; // (start, end, node); if set, parsing stops before a top-level node for which it returns true
+    int startPosition = 0;
+    bool isFinalWindow = false;
+    int safeLimit = 0; // no new match is attempted at or after this position unless it is the final window
+    int resumePosition = 0; // where the next window should start (only set if the window is exhausted)
+    bool isAborted = false;
+    bool isResynced = false;
+
+    TreeBuilder::Node* pendingRecord = nullptr; // the top-level node that is not finished yet
+    int pendingRecordStart = 0;
+
+    // called once no more children can be added to the pending top-level node
+    void finishRecord(TreeBuilder& builder) {
+        if (!pendingRecord)
+            return;
+        if (recordCallback) {
+            Tree tree(builder);
+            if (!(*recordCallback)(tree)) {
+                isAborted = true;
+            }
+            pendingRecord->detach();
+        }
+        pendingRecord = nullptr;
+        pendingRecordStart = 0;
+    }
+
+    // called before a new top-level node is attached to root
+    void startRecord(TreeBuilder::Node* node, int startPos) {
+        Q_ASSERT(!pendingRecord);
+        pendingRecord = node;
+        pendingRecordStart = startPos;
+    }
+
+    void resetWindow(bool isFinal, int limit) {
+        isFinalWindow = isFinal;
+        safeLimit = limit;
+        resumePosition = 0;
+        isResynced = false;
+        pendingRecord = nullptr;
+        pendingRecordStart = 0;
+    }
+};
+
 bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *logger)
+{
+    return performParsingImpl(src, dest, nullptr, logger, nullptr);
+}
+
+bool SimpleParser::performParsing(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>& nodeTextRanges, EventLogger* logger)
+{
+    return performParsingImpl(src, dest, &nodeTextRanges, logger, nullptr);
+}
+
+namespace {
+void copySubtree(TreeBuilder& builder, TreeBuilder::Node* parent,
+                 const Tree& src, const QVector<TextUtil::PlainTextLocation>& srcRanges, int nodeIndex, int posOffset,
+                 QVector<TextUtil::PlainTextLocation>& destRanges)
+{
+    // pre-order walk over an explicit stack so that deep trees do not overflow the call stack
+    // each entry is the source node to copy and the destination parent; children are pushed in reverse order
+    QVector<QPair<int, TreeBuilder::Node*>> stack;
+    stack.push_back(qMakePair(nodeIndex, parent));
+    while (!stack.isEmpty()) {
+        auto entry = stack.takeLast();
+        const Tree::Node& srcNode = src.getNode(entry.first);
+        TreeBuilder::Node* node = builder.addNode(entry.second);
+        node->setDataFromNode(srcNode);
+        const auto& loc = srcRanges.at(entry.first);
+        destRanges.push_back(TextUtil::PlainTextLocation(loc.startPos + posOffset, loc.endPos + posOffset));
+        for (int i = srcNode.offsetToChildren.size() - 1; i >= 0; --i) {
+            stack.push_back(qMakePair(entry.first + srcNode.offsetToChildren.at(i), node));
+        }
+    }
+}
+} // end of anonymous namespace
+
+bool SimpleParser::performIncrementalParsing(const QString& src, int editStart, int removedLength, int insertedLength,
+                                             const Tree& oldTree, const QVector<TextUtil::PlainTextLocation>& oldNodeTextRanges,
+                                             Tree& dest, QVector<TextUtil::PlainTextLocation>& destNodeTextRanges)
+{
+    Q_ASSERT(oldTree.getNumNodes() == oldNodeTextRanges.size());
+    Q_ASSERT(editStart >= 0 && removedLength >= 0 && insertedLength >= 0);
+    if (oldTree.isEmpty()) {
+        return performParsing(src, dest, destNodeTextRanges);
+    }
+
+    const int delta = insertedLength - removedLength;
+    const int oldEditEnd = editStart + removedLength;
+
+    QVector<int> topLevelNodes;
+    for (auto offset : oldTree.getNode(0).offsetToChildren) {
+        topLevelNodes.push_back(offset);
+    }
+
+    // resume from the last top-level node starting before the edit
+    int firstReparsedRecord = 0;
+    int resumePos = 0;
+    for (int i = 0, n = topLevelNodes.size(); i < n; ++i) {
+        int start = oldNodeTextRanges.at(topLevelNodes.at(i)).startPos;
+        if (start >= editStart)
+            break;
+        firstReparsedRecord = i;
+        resumePos = start;
+    }
+
+    // old records completely after the edit, keyed by their start position in new text
+    QHash<int, int> resyncCandidates;
+    for (int i = firstReparsedRecord, n = topLevelNodes.size(); i < n; ++i) {
+        int start = oldNodeTextRanges.at(topLevelNodes.at(i)).startPos;
+        if (start > oldEditEnd) {
+            resyncCandidates.insert(start + delta, i);
+        }
+    }
+
+    PartialParseState partialState;
+    partialState.resetWindow(true, src.length());
+    partialState.startPosition = resumePos;
+    partialState.resyncCheck = [&](int startPos, int endPos, const TreeBuilder::Node* node) -> bool {
+        // the new node must match the old one at the shifted position, not just start there
+        auto iter = resyncCandidates.find(startPos);
+        if (iter == resyncCandidates.end())
+            return false;
+        int oldNodeIndex = topLevelNodes.at(iter.value());
+        if (oldNodeTextRanges.at(oldNodeIndex).endPos + delta != endPos)
+            return false;
+        const Tree::Node& oldNode = oldTree.getNode(oldNodeIndex);
+        return oldNode.typeName == node->typeName
+            && oldNode.keyList == node->keyList
+            && oldNode.valueList == node->valueList;
+    };
+
+    Tree newPart;
+    QVector<TextUtil::PlainTextLocation> newPartRanges;
+    if (!performParsingImpl(src, newPart, &newPartRanges, nullptr, &partialState)) {
+        return false;
+    }
+
+    // splice: old records before the edit, new records, old records after resynchronization
+    TreeBuilder splicedTree;
+    destNodeTextRanges.clear();
+    TreeBuilder::Node* root = splicedTree.addNode(nullptr);
+    root->setDataFromNode(newPart.getNode(0));
+    destNodeTextRanges.push_back(TextUtil::PlainTextLocation(0, src.length()));
+    for (int i = 0; i < firstReparsedRecord; ++i) {
+        copySubtree(splicedTree, root, oldTree, oldNodeTextRanges, topLevelNodes.at(i), 0, destNodeTextRanges);
+    }
+    for (auto offset : newPart.getNode(0).offsetToChildren) {
+        copySubtree(splicedTree, root, newPart, newPartRanges, offset, 0, destNodeTextRanges);
+    }
+    if (partialState.isResynced) {
+        for (int i = resyncCandidates.value(partialState.resumePosition), n = topLevelNodes.size(); i < n; ++i) {
+            copySubtree(splicedTree, root, oldTree, oldNodeTextRanges, topLevelNodes.at(i), delta, destNodeTextRanges);
+        }
+    }
+    Tree result(splicedTree);
+    dest.swap(result);
+    return true;
+}
+
+bool SimpleParser::performStreamingParsing(QIODevice* src, std::function<bool(Tree&)> recordCallback, const StreamingOptions& options)
+{
+    Q_ASSERT(src && src->isReadable());
+    Q_ASSERT(options.windowSize > 0 && options.lookaheadSize >= 0);
+
+    QTextStream stream(src);
+    QTextCodec* codec = QTextCodec::codecForName(options.codecName);
+    if (Q_UNLIKELY(!codec)) {
+        qWarning() << "Unknown codec for streaming parsing:" << options.codecName;
+        return false;
+    }
+    stream.setCodec(codec);
+    stream.setAutoDetectUnicode(true);
+
+    PartialParseState streamState;
+    streamState.recordCallback = &recordCallback;
+
+    // the buffer always starts at the beginning of a top-level record (or whitespace before it)
+    QString buffer;
+    int requiredLength = options.windowSize + options.lookaheadSize;
+    while (true) {
+        while (buffer.length() < requiredLength && !stream.atEnd()) {
+            QString chunk = stream.read(requiredLength - buffer.length());
+            if (chunk.isEmpty()) {
+                // sequential device with no data available yet
+                if (!src->waitForReadyRead(-1)) {
+                    if (stream.atEnd())
+                        break;
+                    qWarning() << "Streaming parsing: waiting for input failed:" << src->errorString();
+                    return false;
+                }
+                continue;
+            }
+            buffer.append(chunk);
+        }
+        bool isFinal = stream.atEnd();
+        streamState.resetWindow(isFinal, isFinal? buffer.length() : buffer.length() - options.lookaheadSize);
+
+        Tree tree;
+        bool isGood = performParsingImpl(buffer, tree, nullptr, nullptr, &streamState);
+        if (!isGood || streamState.isAborted) {
+            return false;
+        }
+
+        if (isFinal) {
+            // the last record is left in the tree
+            if (!tree.isEmpty() && !tree.getNode(0).offsetToChildren.isEmpty()) {
+                if (!recordCallback(tree)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int resume = streamState.resumePosition;
+        if (resume > 0) {
+            // drop all consumed text; the unfinished record is parsed again in the next window
+            buffer.remove(0, resume);
+            requiredLength = options.windowSize + options.lookaheadSize;
+        } else {
+            // the record is larger than the window; grow the window geometrically so that the re-parsing stays linear overall
+            requiredLength = qMax(buffer.length() + options.windowSize, buffer.length() * 2);
+        }
+    }
+}
+
+bool SimpleParser::performParsingImpl(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>* nodeTextRanges, EventLogger *logger, PartialParseState* stream)
+{
+    QElapsedTimer timer;
+    if (isProfiling) {
+        timer.start();
+    }
+    bool isGood = logger? performParsingVariant<true>(src, dest, nodeTextRanges, logger, stream)
+                        : performParsingVariant<false>(src, dest, nodeTextRanges, nullptr, stream);
+    if (isProfiling) {
+        profileReport.numParses += 1;
+        profileReport.totalParseTimeNs += timer.nsecsElapsed();
+        profileReport.totalParsedChars += src.length();
+        const auto& stats = state.cacheStatistics;
+        profileReport.cache.peakNumEntries = qMax(profileReport.cache.peakNumEntries, stats.peakNumEntries);
+        profileReport.cache.peakEstimatedSize = qMax(profileReport.cache.peakEstimatedSize, stats.peakEstimatedSize);
+        profileReport.cache.numEvictedEntries += stats.numEvictedEntries;
+    }
+    return isGood;
+}
+
+template <bool IsTraced>
+bool SimpleParser::performParsingVariant(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>* nodeTextRanges, EventLogger *logger, PartialParseState* stream)
 {
     state.clear();
     builder.clear();
 
     state.set(src, logger);
+    if (stream) {
+        state.curPosition = stream->startPosition;
+    }
 
     struct RuleStackFrame {
         TreeBuilder::Node* ptr = nullptr;
@@ -204,26 +816,32 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
     };
     QVector<RuleStackFrame> ruleStack;
 
-    int pos = 0;
+    int pos = stream? stream->startPosition : 0;
     int lastEventChangingPos = -1;
     int lastEventChangingFrame = -1;
     int length = src.length();
     QHash<int, int> treeNodeSequenceNumberToEventMap; // [sequence number] -> <node add event id>
+    QHash<int, std::pair<int, int>> treeNodeSequenceNumberToRangeMap; // [sequence number] -> <start pos, end pos>; only populated if nodeTextRanges is requested
 
     auto skipEmptyLines = [&]() -> void {
         int startPos = pos;
-        QStringRef str = src.midRef(pos);
-        auto match = emptyLineRegex.match(str, 0, QRegularExpression::NormalMatch, QRegularExpression::AnchoredMatchOption);
-        if (match.hasMatch()) {
-            int matchStart = match.capturedStart();
-            int matchEnd = match.capturedEnd();
-            Q_ASSERT(matchStart == 0);
-            int dist = matchEnd;
-            pos += dist;
+        // skip lines that consist only of white spaces
+        const QChar* text = src.constData();
+        int cur = pos;
+        while (cur < length) {
+            int lineFeedPos = cur + grammar->whitespaceClassifier.runLength(text, cur, length);
+            if (lineFeedPos >= length || text[lineFeedPos] != '\n')
+                break;
+            cur = lineFeedPos + 1;
+        }
+        if (cur > startPos) {
+            pos = cur;
             state.curPosition = pos;
-            auto startPosPair = state.posInfo.getLineAndColumnNumber(startPos);
-            auto endPosPair = state.posInfo.getLineAndColumnNumber(pos-1);
-            lastEventChangingPos = SimpleParserEvent::Log(SimpleParserEvent::EmptyLineSkipped, logger, startPos, pos, startPosPair.first, endPosPair.first);
+            if (IsTraced) {
+                auto startPosPair = state.posInfo.getLineAndColumnNumber(startPos);
+                auto endPosPair = state.posInfo.getLineAndColumnNumber(pos-1);
+                lastEventChangingPos = SimpleParserEvent::Log(SimpleParserEvent::EmptyLineSkipped, logger, startPos, pos, startPosPair.first, endPosPair.first);
+            }
         }
     };
 
@@ -285,15 +903,31 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
     {
         int rootNodeEventID = SimpleParserEvent::Log(SimpleParserEvent::RootNodeCreation, logger);
         auto* rootPtr = builder.addNode(nullptr);
-        pushFrame(rootPtr, childNodeMatchRules.back(), rootNodeEventID);
+        pushFrame(rootPtr, grammar->childNodeMatchRules.back(), rootNodeEventID);
         lastEventChangingFrame = rootNodeEventID;
-        treeNodeSequenceNumberToEventMap.insert(rootPtr->getSequenceNumber(), rootNodeEventID);
+        if (IsTraced) {
+            treeNodeSequenceNumberToEventMap.insert(rootPtr->getSequenceNumber(), rootNodeEventID);
+        }
+        if (nodeTextRanges) {
+            treeNodeSequenceNumberToRangeMap.insert(rootPtr->getSequenceNumber(), std::make_pair(0, length));
+        }
+    }
+
+    // one clock per parse for per-pattern timing; only started when profiling
+    QElapsedTimer patternClock;
+    if (isProfiling) {
+        patternClock.start();
     }
 
     // main loop
     bool isMatchFailed = false;
+    bool isWindowExhausted = false;
     while (!ruleStack.isEmpty() && (pos < length)) {
-        if (data.flag_skipEmptyLineBeforeMatching) {
+        if (stream && (stream->isAborted || stream->isResynced)) {
+            break;
+        }
+
+        if (grammar->data.flag_skipEmptyLineBeforeMatching) {
             skipEmptyLines();
         }
 
@@ -301,6 +935,11 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
             break;
         }
 
+        if (stream && !stream->isFinalWindow && pos >= stream->safeLimit) {
+            isWindowExhausted = true;
+            break;
+        }
+
         const auto& frame = ruleStack.back();
         const auto passData = frame.passData; // implicit sharing; create another reference so that no bad access is made when frame is poped inside the body
         QList<int> passMatchFailEvents;
@@ -318,20 +957,57 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
             int bestResultRuleNodeIndex = -1;
             int bestResultPatternIndex = -1;
 
+            // without tracing, patterns whose literal prefix do not appear here are skipped; they would fail anyway
+            // the sequential engine is kept as the unoptimized reference and always tries every pattern
+            const bool isPrefixFiltered = !IsTraced && isUntracedFastPathEnabled && patternEngine != PatternEngine::Sequential;
+            if (isPrefixFiltered) {
+                curPassData.prefixTrie.match(src, pos, prefixCandidates);
+            }
+            int patternOrdinal = -1;
             for(auto iter = curPassData.patterns.begin(), iterEnd = curPassData.patterns.end(); iter != iterEnd; ++iter) {
                 int matchRuleNodeIndex = iter.key();
-                const auto& patterns = data.matchRuleNodes.at(matchRuleNodeIndex).patterns;
+                const auto& patterns = grammar->data.matchRuleNodes.at(matchRuleNodeIndex).patterns;
                 for (int patternIndex : iter.value()) {
+                    patternOrdinal += 1;
+                    if (isPrefixFiltered && !prefixCandidates[patternOrdinal]) {
+                        continue;
+                    }
                     const auto& curPattern = patterns.at(patternIndex);
-                    PatternMatchResult curResult = tryPattern(curPattern, pos, frame.event);
-                    if (logger) {
+                    const LiteralPatternInfo& literalInfo = grammar->literalPatternInfo.at(matchRuleNodeIndex).at(patternIndex);
+                    qint64 patternStartNs = 0;
+                    if (isProfiling) {
+                        currentProfilePattern = patternProfileIndexBase.at(matchRuleNodeIndex) + patternIndex;
+                        patternStartNs = patternClock.nsecsElapsed();
+                    }
+                    PatternMatchResult curResult;
+                    if (Q_UNLIKELY(patternEngine == PatternEngine::Sequential)) {
+                        curResult = tryPattern_v1(curPattern, pos, frame.event);
+                    } else if (!IsTraced && isUntracedFastPathEnabled && literalInfo.isLiteralOnly) {
+                        curResult = tryLiteralPattern(curPattern, literalInfo, pos);
+                    } else {
+                        curResult = tryPatternVariant<IsTraced>(curPattern, pos, frame.event);
+                    }
+                    if (isProfiling) {
+                        auto& record = profileReport.patterns[currentProfilePattern];
+                        record.numAttempts += 1;
+                        record.totalTimeNs += patternClock.nsecsElapsed() - patternStartNs;
+                        if (curResult) {
+                            record.numSuccesses += 1;
+                        }
+                        currentProfilePattern = -1;
+                    }
+                    if (IsTraced) {
                         Q_ASSERT(curResult.nodeFinalEvent >= 0);
                     }
                     if (!curResult) {
-                        negativeMatchEvents.push_back(curResult.nodeFinalEvent);
+                        if (IsTraced) {
+                            negativeMatchEvents.push_back(curResult.nodeFinalEvent);
+                        }
                         continue;
                     }
-                    positiveMatchEvents.push_back(curResult.nodeFinalEvent);
+                    if (IsTraced) {
+                        positiveMatchEvents.push_back(curResult.nodeFinalEvent);
+                    }
                     if (!curBestResult || curResult.isBetterThan(curBestResult)) {
                         // first match
                         curBestResult = curResult;
@@ -371,10 +1047,29 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
                 }
 
                 TreeBuilder::Node* parent = bestMatchFrame.ptr;
+                if (stream && frameIndex == 0) {
+                    // frames of the previous record (if any) are dropped below; it is complete now
+                    stream->finishRecord(builder);
+                    if (stream->isAborted) {
+                        break;
+                    }
+                    if (stream->resyncCheck && stream->resyncCheck(startPos, pos, node)) {
+                        // the rest is the same as the last parse; the node is dropped
+                        stream->isResynced = true;
+                        stream->resumePosition = startPos;
+                        break;
+                    }
+                    stream->startRecord(node, startPos);
+                }
                 node->setParent(parent);
 
                 int nodeAddEvent = SimpleParserEvent::Log(SimpleParserEvent::NodeAdded, logger, node->typeName, frame.event, curBestResult.nodeFinalEvent, positiveMatchEvents, negativeMatchEvents, startPos, pos);
-                treeNodeSequenceNumberToEventMap.insert(node->getSequenceNumber(), nodeAddEvent);
+                if (IsTraced) {
+                    treeNodeSequenceNumberToEventMap.insert(node->getSequenceNumber(), nodeAddEvent);
+                }
+                if (nodeTextRanges) {
+                    treeNodeSequenceNumberToRangeMap.insert(node->getSequenceNumber(), std::make_pair(startPos, pos));
+                }
 
                 if (frameIndex != ruleStack.size() - 1) {
                     // we are not matching at the top most frame
@@ -384,7 +1079,7 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
                 }
 
 
-                const auto& childRules = childNodeMatchRules.at(bestResultRuleNodeIndex);
+                const auto& childRules = grammar->childNodeMatchRules.at(bestResultRuleNodeIndex);
                 if (!childRules.isEmpty()) {
                     pushFrame(node, childRules, nodeAddEvent);
                     lastEventChangingFrame = nodeAddEvent;
@@ -399,18 +1094,45 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
             isMatchFailed = true;
             break;
         }
+        if (stream && stream->pendingRecord && ruleStack.size() == 1 && !stream->isResynced) {
+            // only the root frame is left; emit the record now instead of waiting for the next one
+            stream->finishRecord(builder);
+        }
+    }
+
+    if (stream && (isWindowExhausted || stream->isAborted)) {
+        stream->resumePosition = stream->pendingRecord? stream->pendingRecordStart : pos;
+        state.clear();
+        builder.clear();
+        return !stream->isAborted;
     }
 
     int finishEvent = SimpleParserEvent::Log(SimpleParserEvent::MatchFinished, logger, lastEventChangingFrame, pos);
     QVector<int> sequenceNumberTable;
-    Tree tree(builder, sequenceNumberTable);
-    dest.swap(tree);
+    if (IsTraced || nodeTextRanges) {
+        Tree tree(builder, sequenceNumberTable);
+        dest.swap(tree);
+    } else {
+        Tree tree(builder);
+        dest.swap(tree);
+    }
+
+    if (IsTraced) {
+        for (int i = 0, n = sequenceNumberTable.size(); i < n; ++i) {
+            int seqNum = sequenceNumberTable.at(i);
+            auto iter = treeNodeSequenceNumberToEventMap.find(seqNum);
+            Q_ASSERT(iter != treeNodeSequenceNumberToEventMap.end());
+            SimpleParserEvent::Log(SimpleParserEvent::TextToNodePositionMapping, logger, i, iter.value());
+        }
+    }
 
-    for (int i = 0, n = sequenceNumberTable.size(); i < n; ++i) {
-        int seqNum = sequenceNumberTable.at(i);
-        auto iter = treeNodeSequenceNumberToEventMap.find(seqNum);
-        Q_ASSERT(iter != treeNodeSequenceNumberToEventMap.end());
-        SimpleParserEvent::Log(SimpleParserEvent::TextToNodePositionMapping, logger, i, iter.value());
+    if (nodeTextRanges) {
+        nodeTextRanges->clear();
+        nodeTextRanges->reserve(sequenceNumberTable.size());
+        for (int seqNum : sequenceNumberTable) {
+            auto range = treeNodeSequenceNumberToRangeMap.value(seqNum);
+            nodeTextRanges->push_back(TextUtil::PlainTextLocation(range.first, range.second));
+        }
     }
 
     if (isMatchFailed) {
@@ -420,26 +1142,27 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
         return false;
     }
 
+    if (stream && stream->isResynced) {
+        // remaining text is already checked by the previous parse
+        state.clear();
+        builder.clear();
+        return true;
+    }
+
     // check if all text is consumed
     while (pos < src.length()) {
-        QStringRef str(&src, pos, src.length() - pos);
-        bool isWhiteSpaceFound = false;
-        if (str.startsWith('\n')) {
+        if (src.at(pos) == '\n') {
             pos += 1;
             continue;
         }
-        for (const auto& ws : data.whitespaceList) {
-            if (str.startsWith(ws)) {
-                pos += ws.length();
-                isWhiteSpaceFound = true;
-                break;
-            }
-        }
-        if (isWhiteSpaceFound)
+        int wsLength = grammar->whitespaceClassifier.matchForward(src.constData(), pos, src.length());
+        if (wsLength > 0) {
+            pos += wsLength;
             continue;
+        }
 
         // we find strings that are not "whitespace"
-        SimpleParserEvent::Log(SimpleParserEvent::GarbageAtEnd, logger, str.position(), finishEvent);
+        SimpleParserEvent::Log(SimpleParserEvent::GarbageAtEnd, logger, pos, finishEvent);
         return false;
     }
 
@@ -452,6 +1175,22 @@ bool SimpleParser::performParsing(const QString& src, Tree& dest, EventLogger *l
     return true;
 }
 
+namespace {
+qint64 getStringLiteralCacheEntrySize()
+{
+    return static_cast<qint64>(sizeof(QMapNode<int, int>));
+}
+
+qint64 getRegexCacheEntrySize(const SimpleParser::ParseState::RegexMatchData& data)
+{
+    qint64 size = static_cast<qint64>(sizeof(QMapNode<int, std::pair<int, SimpleParser::ParseState::RegexMatchData>>));
+    if (!data.namedCaptures.isEmpty()) {
+        size += static_cast<qint64>(sizeof(QArrayData) + sizeof(QStringRef) * static_cast<size_t>(data.namedCaptures.size()));
+    }
+    return size;
+}
+} // end of anonymous namespace
+
 void SimpleParser::ParseState::clear()
 {
     stringLiteralPositionMap.clear();
@@ -461,6 +1200,13 @@ void SimpleParser::ParseState::clear()
     str = nullptr;
     logger = nullptr;
     posInfo = TextUtil::TextPositionInfo();
+    numCacheEntries = 0;
+    estimatedCacheSize = 0;
+    cacheUseTick = 0;
+    stringLiteralLastUse.clear();
+    for (auto& tick : regexLastUse) {
+        tick = 0;
+    }
 
     // the following two is persistent across uses
     // regexPatternToIndexMap.clear();
@@ -473,7 +1219,97 @@ void SimpleParser::ParseState::set(const QString& text, EventLogger* loggerArg)
     logger = loggerArg;
     strLength = text.length();
     curPosition = 0;
+    // the line index is only built when a diagnostic needs it
     posInfo = TextUtil::TextPositionInfo(text);
+    cacheStatistics = MatchCacheStatistics();
+    std::fill(classBasedSearchMemo.begin(), classBasedSearchMemo.end(), std::make_pair(-1, -1));
+}
+
+void SimpleParser::ParseState::addCacheEntry(qint64 size)
+{
+    numCacheEntries += 1;
+    estimatedCacheSize += size;
+    cacheStatistics.peakNumEntries = qMax(cacheStatistics.peakNumEntries, numCacheEntries);
+    cacheStatistics.peakEstimatedSize = qMax(cacheStatistics.peakEstimatedSize, estimatedCacheSize);
+}
+
+void SimpleParser::ParseState::removeCacheEntry(qint64 size, bool isEvicted)
+{
+    numCacheEntries -= 1;
+    estimatedCacheSize -= size;
+    if (isEvicted) {
+        cacheStatistics.numEvictedEntries += 1;
+    }
+}
+
+void SimpleParser::ParseState::enforceCacheLimits(const QString* literal, int regexIndex)
+{
+    // per-cache limit; entries at the end are the farthest from the current position
+    if (cacheOptions.maxEntriesPerCache > 0) {
+        if (literal) {
+            auto& map = stringLiteralPositionMap[*literal];
+            while (map.size() > cacheOptions.maxEntriesPerCache) {
+                auto last = map.end();
+                --last;
+                map.erase(last);
+                removeCacheEntry(getStringLiteralCacheEntrySize(), true);
+            }
+        } else {
+            auto& map = regexMatchPositionMap[regexIndex];
+            while (map.size() > cacheOptions.maxEntriesPerCache) {
+                auto last = map.end();
+                --last;
+                qint64 size = getRegexCacheEntrySize(last.value().second);
+                map.erase(last);
+                removeCacheEntry(size, true);
+            }
+        }
+    }
+
+    // overall budget; drop the least recently used cache other than the one in use until we are within the budget
+    while (cacheOptions.memoryBudget > 0 && estimatedCacheSize > cacheOptions.memoryBudget) {
+        quint64 lruTick = std::numeric_limits<quint64>::max();
+        QString lruLiteral;
+        bool isLRULiteral = false;
+        int lruRegexIndex = -1;
+        for (auto iter = stringLiteralPositionMap.cbegin(), iterEnd = stringLiteralPositionMap.cend(); iter != iterEnd; ++iter) {
+            if (iter.value().isEmpty() || (literal && iter.key() == *literal))
+                continue;
+            quint64 tick = stringLiteralLastUse.value(iter.key(), 0);
+            if (tick < lruTick) {
+                lruTick = tick;
+                lruLiteral = iter.key();
+                isLRULiteral = true;
+            }
+        }
+        for (int i = 0, n = regexMatchPositionMap.size(); i < n; ++i) {
+            if (regexMatchPositionMap.at(i).isEmpty() || (!literal && i == regexIndex))
+                continue;
+            quint64 tick = regexLastUse.at(i);
+            if (tick < lruTick) {
+                lruTick = tick;
+                lruRegexIndex = i;
+                isLRULiteral = false;
+            }
+        }
+
+        if (isLRULiteral) {
+            auto& map = stringLiteralPositionMap[lruLiteral];
+            for (int i = 0, n = map.size(); i < n; ++i) {
+                removeCacheEntry(getStringLiteralCacheEntrySize(), true);
+            }
+            map.clear();
+        } else if (lruRegexIndex >= 0) {
+            auto& map = regexMatchPositionMap[lruRegexIndex];
+            for (auto iter = map.cbegin(), iterEnd = map.cend(); iter != iterEnd; ++iter) {
+                removeCacheEntry(getRegexCacheEntrySize(iter.value().second), true);
+            }
+            map.clear();
+        } else {
+            // only the cache in use is left
+            break;
+        }
+    }
 }
 
 int SimpleParser::ParseState::getRegexIndex(const QString& pattern)
@@ -481,11 +1317,11 @@ int SimpleParser::ParseState::getRegexIndex(const QString& pattern)
     int regexIndex = regexPatternToIndexMap.value(pattern, -1);
     if (regexIndex == -1) {
         regexIndex = regexList.size();
-        QRegularExpression regex(pattern, QRegularExpression::MultilineOption | QRegularExpression::DontCaptureOption | QRegularExpression::UseUnicodePropertiesOption);
-        Q_ASSERT(regex.isValid());
-        regexList.push_back(regex);
+        regexList.push_back(compileRegex(pattern));
         regexPatternToIndexMap.insert(pattern, regexIndex);
         regexMatchPositionMap.push_back(QMap<int, std::pair<int, ParseState::RegexMatchData>>());
+        regexLastUse.push_back(0);
+        isRegexCaptureStored.push_back(false);
     }
     return regexIndex;
 }
@@ -550,7 +1386,7 @@ SimpleParser::PatternMatchResult SimpleParser::tryPattern_v1(const Pattern& patt
             if (pe.str.isEmpty()) {
                 contentIndex = 0;
             } else {
-                contentIndex = contentTypeNameToIndexMap.value(pe.str, -1);
+                contentIndex = grammar->contentTypeNameToIndexMap.value(pe.str, -1);
                 Q_ASSERT(contentIndex != -1);
             }
             const PatternElement& nextPE = pattern.pattern.at(nextElementIndex);
@@ -801,11 +1637,9 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
         Q_ASSERT(!pinUB);
 
         int regexIndex = state.getRegexIndex(regexExpr);
-        const QRegularExpression& regex = state.regexList.at(regexIndex);
-        auto& positionMap = state.regexMatchPositionMap[regexIndex];
 
         // we will have to do one round of matching no matter what
-        std::pair<int,int> dists = findNextRegexMatch(holeLB_abs, regex, positionMap);
+        std::pair<int,int> dists = findNextRegexMatch(holeLB_abs, regexIndex);
         if (dists.first < 0) {
             // no matches
             return;
@@ -821,8 +1655,6 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
 
         int start = holeLB_abs + dists.first;
         int end = start + dists.second;
-        // debug code
-        qDebug() << "Regex match:" << holeLB_abs << holeUB_abs << "->" << start << "; regex " << regexExpr << " -> " << state.str->midRef(start, end-start);
         result.push_back(std::make_pair(start, end));
     };
     auto populateAsStringListConcatenation = [=,&result](const QStringList& strList) -> void {
@@ -887,17 +1719,8 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
                 // now we find the first occurrence of a whitespace in [minPos, minPos + consumedLength)
                 // consume as much text as possible
                 int newStart = minPos + consumedLength;
-                QStringRef testStr = state.str->midRef(newStart, holeUB_abs - newStart);
-                bool isImprovementMade = true;
-                while (isImprovementMade) {
-                    isImprovementMade = false;
-                    for (const auto& str : strList) {
-                        if (testStr.startsWith(str)) {
-                            testStr = testStr.mid(str.length());
-                            consumedLength += str.length();
-                            isImprovementMade = true;
-                        }
-                    }
+                if (newStart < holeUB_abs) {
+                    consumedLength += grammar->whitespaceClassifier.runLength(state.str->constData(), newStart, holeUB_abs);
                 }
                 result.push_back(std::make_pair(minPos, minPos + consumedLength));
                 curPos = minPos + consumedLength + 1;
@@ -916,11 +1739,22 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
         populateAsRegex(element.str);
     }break;
     case PatternElement::ElementType::AnonymousBoundary_SpecialCharacter_WhiteSpaces: {
-        populateAsStringListConcatenation(data.whitespaceList);
+        if (isProfiling) {
+            // the hole is the upper bound of what is scanned
+            auto& record = getBoundaryProfileRecord(BoundaryType::SpecialCharacter_WhiteSpaces, QString());
+            record.numSearches += 1;
+            record.numScannedChars += holeUB_abs - holeLB_abs;
+        }
+        populateAsStringListConcatenation(grammar->data.whitespaceList);
     }break;
     case PatternElement::ElementType::AnonymousBoundary_SpecialCharacter_OptionalWhiteSpace: {
+        if (isProfiling) {
+            auto& record = getBoundaryProfileRecord(BoundaryType::SpecialCharacter_OptionalWhiteSpace, QString());
+            record.numSearches += 1;
+            record.numScannedChars += holeUB_abs - holeLB_abs;
+        }
         if (holeLB_abs < holeUB_abs) {
-            populateAsStringListConcatenation(data.whitespaceList);
+            populateAsStringListConcatenation(grammar->data.whitespaceList);
             if (result.empty()) {
                 int pos = (pinUB)? holeUB_abs : holeLB_abs;
                 result.push_back(std::make_pair(pos, pos));
@@ -932,21 +1766,34 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
         }
     }break;
     case PatternElement::ElementType::NamedBoundary: {
-        qFatal("NamedBoundary unimplemented in new parser core yet");
+        // resolved the same way as in the sequential engine
+        // like other boundaries, only the first occurrence is used: one search from the start of the hole, then the constraints are checked on that hit
+        BoundaryDeclaration decl;
+        decl.decl = BoundaryDeclaration::DeclarationType::NameReference;
+        decl.ty = BoundaryType::StringLiteral; // won't be used anyway
+        decl.str = element.str;
+        std::pair<int, int> dists = findBoundary(holeLB_abs, decl, pinLB? -1 : AnyContentTypeIndex, false);
+        if (dists.first >= 0) {
+            int start = holeLB_abs + dists.first;
+            int end = start + dists.second;
+            if (end <= holeUB_abs && (!pinUB || end == holeUB_abs)) {
+                result.push_back(std::make_pair(start, end));
+            }
+        }
     }break;
     case PatternElement::ElementType::Content: {
         // for contents, we currently just try to make it consume the entire space
         int contentTypeIndex = -1;
         if (!element.str.isEmpty()) {
-            contentTypeIndex = contentTypeNameToIndexMap.value(element.str, -1);
+            contentTypeIndex = grammar->contentTypeNameToIndexMap.value(element.str, -1);
             // we may have undefined contents; we just accept everything
             // Q_ASSERT(contentTypeIndex >= 0);
         }
         if (contentTypeIndex == -1) {
             result.push_back(std::make_pair(holeLB_abs, holeUB_abs));
         } else {
-            const ContentType& c = data.contentTypes.at(contentTypeIndex);
-            int checkResult = contentCheck(c, holeLB_abs, holeUB_abs - holeLB_abs, false);
+            const ContentType& c = grammar->data.contentTypes.at(contentTypeIndex);
+            int checkResult = contentCheck(&c, holeLB_abs, holeUB_abs - holeLB_abs, false);
             if (checkResult == 0) {
                 result.push_back(std::make_pair(holeLB_abs, holeUB_abs));
             }
@@ -958,6 +1805,15 @@ std::vector<std::pair<int, int>> SimpleParser::tryMatchPatternElement(const Patt
 }
 
 SimpleParser::PatternMatchResult SimpleParser::tryPattern(const Pattern& pattern, int position, int patternTestSourceEvent)
+{
+    if (state.logger) {
+        return tryPatternVariant<true>(pattern, position, patternTestSourceEvent);
+    }
+    return tryPatternVariant<false>(pattern, position, patternTestSourceEvent);
+}
+
+template <bool IsTraced>
+SimpleParser::PatternMatchResult SimpleParser::tryPatternVariant(const Pattern& pattern, int position, int patternTestSourceEvent)
 {
     const std::vector<indextype> elementSolveOrder = getPatternElementSolvingOrder(pattern);
     Q_ASSERT(elementSolveOrder.size() == static_cast<decltype(elementSolveOrder.size())>(pattern.pattern.size()));
@@ -1059,6 +1915,9 @@ SimpleParser::PatternMatchResult SimpleParser::tryPattern(const Pattern& pattern
         );
         if (results.empty()) {
             // no matches
+            if (!IsTraced) {
+                continue;
+            }
             PatternMatchFailAttempts failData;
             failData.failElement = nextPE;
             const auto& pe = pattern.pattern.at(nextPE);
@@ -1112,11 +1971,16 @@ SimpleParser::PatternMatchResult SimpleParser::tryPattern(const Pattern& pattern
                 }
             }
             int matchEnd = matchPosVec.back().second;
+            if (isProfiling && currentProfilePattern >= 0) {
+                profileReport.patterns[currentProfilePattern].numSearchEntries += searchRecords.size();
+            }
             SimpleParser::PatternMatchResult result;
             result.node = node;
             result.boundaryConsumedLength = matchEnd - startAbsolutePosition - contentCount;
             result.totalConsumedLength = matchEnd - startAbsolutePosition;
-            result.nodeFinalEvent = SimpleParserEvent::Log(SimpleParserEvent::PatternMatched, state.logger, startAbsolutePosition, matchEnd, patternTestSourceEvent, matchPosVec);
+            if (IsTraced) {
+                result.nodeFinalEvent = SimpleParserEvent::Log(SimpleParserEvent::PatternMatched, state.logger, startAbsolutePosition, matchEnd, patternTestSourceEvent, matchPosVec);
+            }
             return result;
         }
 
@@ -1136,28 +2000,75 @@ SimpleParser::PatternMatchResult SimpleParser::tryPattern(const Pattern& pattern
 
     // okay, stack is empty but we have not returned yet
     // this is a match failure
+    if (isProfiling && currentProfilePattern >= 0) {
+        profileReport.patterns[currentProfilePattern].numSearchEntries += searchRecords.size();
+    }
     SimpleParser::PatternMatchResult result;
-    result.nodeFinalEvent = SimpleParserEvent::Log(SimpleParserEvent::PatternNotMatched, state.logger, startAbsolutePosition, startAbsolutePosition, patternTestSourceEvent, failAttempts);
+    if (IsTraced) {
+        result.nodeFinalEvent = SimpleParserEvent::Log(SimpleParserEvent::PatternNotMatched, state.logger, startAbsolutePosition, startAbsolutePosition, patternTestSourceEvent, failAttempts);
+    }
     return result;
 }
 
-int SimpleParser::getWhitespaceTailChopLength(int startPos, int length)
+SimpleParser::PatternMatchResult SimpleParser::tryLiteralPattern(const Pattern& pattern, const LiteralPatternInfo& info, int position)
 {
-    int totalLength = 0;
-    QStringRef strRef = state.str->midRef(startPos, length);
-    bool isChanged = true;
-    while (isChanged) {
-        isChanged = false;
-        for (const auto& ws : qAsConst(data.whitespaceList)) {
-            if (strRef.endsWith(ws)) {
-                int len = ws.length();
-                totalLength += len;
-                strRef.chop(len);
-                isChanged = true;
+    Q_ASSERT(info.isLiteralOnly);
+    PatternMatchResult result;
+    if (!state.str->midRef(position).startsWith(info.prefix)) {
+        return result;
+    }
+    int prefixEnd = position + info.prefix.length();
+    int matchEnd = prefixEnd;
+    int contentCount = 0;
+    const int numElements = pattern.pattern.size();
+    if (info.numPrefixElements < numElements) {
+        // trailing content takes the rest of text, the same as in tryPattern
+        const auto& pe = pattern.pattern.back();
+        Q_ASSERT(pe.ty == PatternElement::ElementType::Content);
+        int contentTypeIndex = pe.str.isEmpty()? -1 : grammar->contentTypeNameToIndexMap.value(pe.str, -1);
+        if (contentTypeIndex >= 0) {
+            const ContentType& c = grammar->data.contentTypes.at(contentTypeIndex);
+            if (contentCheck(&c, prefixEnd, state.strLength - prefixEnd, false) != 0) {
+                return result;
             }
         }
+        matchEnd = state.strLength;
+        contentCount = matchEnd - prefixEnd;
+    }
+
+    TreeBuilder::Node* node = builder.allocateNode();
+    node->typeName = pattern.typeName;
+    int elementStart = position;
+    for (int i = 0; i < numElements; ++i) {
+        const auto& pe = pattern.pattern.at(i);
+        int elementEnd = matchEnd;
+        if (i < info.numPrefixElements) {
+            elementEnd = elementStart + ((pe.ty == PatternElement::ElementType::AnonymousBoundary_SpecialCharacter_LineFeed)? 1 : pe.str.length());
+        }
+        if (!pe.elementName.isEmpty()) {
+            node->keyList.push_back(pe.elementName);
+            node->valueList.push_back(state.str->mid(elementStart, elementEnd - elementStart));
+        }
+        elementStart = elementEnd;
+    }
+    result.node = node;
+    result.boundaryConsumedLength = matchEnd - position - contentCount;
+    result.totalConsumedLength = matchEnd - position;
+    return result;
+}
+
+int SimpleParser::getWhitespaceTailChopLength(int startPos, int length)
+{
+    const QChar* text = state.str->constData();
+    int end = qMin(startPos + length, state.strLength);
+    int cur = end;
+    while (cur > startPos) {
+        int len = grammar->whitespaceClassifier.matchBackward(text, startPos, cur);
+        if (len == 0)
+            break;
+        cur -= len;
     }
-    return totalLength;
+    return end - cur;
 }
 
 std::pair<int, int> SimpleParser::findBoundary(int pos, const BoundaryDeclaration& decl, int precedingContentTypeIndex, bool chopWSAfterContent)
@@ -1178,8 +2089,8 @@ std::pair<int, int> SimpleParser::findBoundary(int pos, const BoundaryDeclaratio
         }
     }break;
     case BoundaryDeclaration::DeclarationType::NameReference: {
-        int index = boundaryNameToIndexMap.value(decl.str, -1);
-        const NamedBoundary& b = data.namedBoundaries.at(index);
+        int index = grammar->boundaryNameToIndexMap.value(decl.str, -1);
+        const NamedBoundary& b = grammar->data.namedBoundaries.at(index);
         switch (b.ty) {
         case BoundaryType::Concatenation: {
             if (b.elements.isEmpty()) {
@@ -1213,36 +2124,88 @@ std::pair<int, int> SimpleParser::findBoundary(int pos, const BoundaryDeclaratio
 
 std::pair<int, int> SimpleParser::findBoundary_ClassBased(int pos, int boundaryIndex, int precedingContentTypeIndex, bool chopWSAfterContent)
 {
-    const NamedBoundary& boundary = data.namedBoundaries.at(boundaryIndex);
-    Q_ASSERT(boundary.ty == BoundaryType::ClassBased);
+    Q_ASSERT(grammar->data.namedBoundaries.at(boundaryIndex).ty == BoundaryType::ClassBased);
+    auto iter = grammar->classBasedMatchers.find(boundaryIndex);
+    Q_ASSERT(iter != grammar->classBasedMatchers.end());
+    const ClassBasedMatcher& matcher = iter.value();
+
+    // the earliest match wins; among matches at the same position, the longest wins
     std::pair<int, int> bestResult(-1, 0);
-    for (const auto& decl : boundary.elements) {
-        std::pair<int, int> curResult = findBoundary(pos, decl, precedingContentTypeIndex, chopWSAfterContent);
+    auto updateBestResult = [&bestResult](const std::pair<int, int>& curResult) -> void {
         if (curResult.first < 0)
-            continue;
+            return;
         if ((bestResult.first == -1) || (bestResult.first > curResult.first) || (bestResult.first == curResult.first && bestResult.second < curResult.second)) {
             bestResult = curResult;
         }
+    };
+    if (matcher.literals.numPatterns > 0) {
+        updateBestResult(findBoundary_ClassBasedLiterals(pos, boundaryIndex, matcher.literals, precedingContentTypeIndex, chopWSAfterContent));
     }
-    auto iter = classBasedBoundaryChildList.find(boundaryIndex);
-    Q_ASSERT(iter != classBasedBoundaryChildList.end());
-    for (int child : iter.value()) {
-        std::pair<int, int> curResult = findBoundary_ClassBased(pos, child, precedingContentTypeIndex, chopWSAfterContent);
-        if (curResult.first < 0)
-            continue;
-        if ((bestResult.first == -1) || (bestResult.first > curResult.first) || (bestResult.first == curResult.first && bestResult.second < curResult.second)) {
-            bestResult = curResult;
+    for (const auto& decl : matcher.otherElements) {
+        updateBestResult(findBoundary(pos, decl, precedingContentTypeIndex, chopWSAfterContent));
+    }
+    return bestResult;
+}
+
+std::pair<int, int> SimpleParser::findBoundary_ClassBasedLiterals(int pos, int boundaryIndex, const LiteralPrefixTrie& literals, int precedingContentTypeIndex, bool chopWSAfterContent)
+{
+    const QChar* text = state.str->constData();
+    int end = state.strLength;
+    if (precedingContentTypeIndex == -1) {
+        int length = literals.matchLongest(text, pos, end);
+        if (length < 0) {
+            return std::make_pair(-1, 0);
         }
+        return std::make_pair(0, length);
     }
 
-    return bestResult;
+    // same as searching each literal with findBoundary_StringLiteral, but all literals are tried at each position in one scan
+    const ContentType* c = getPrecedingContentType(precedingContentTypeIndex);
+    auto& memo = state.classBasedSearchMemo[boundaryIndex];
+    int curPos = pos;
+    while (true) {
+        int hitPos = -1;
+        if (memo.first >= 0 && memo.first <= curPos && (memo.second == -1 || curPos <= memo.second)) {
+            // no literal between the last search start and its result
+            hitPos = memo.second;
+        } else {
+            for (int i = curPos; i <= end; ++i) {
+                if (literals.matchLongest(text, i, end) >= 0) {
+                    hitPos = i;
+                    break;
+                }
+            }
+            memo = std::make_pair(curPos, hitPos);
+        }
+        if (hitPos == -1) {
+            return std::make_pair(-1, 0);
+        }
+        int result = contentCheck(c, curPos, hitPos - curPos, chopWSAfterContent);
+        if (result < 0) {
+            return std::make_pair(-1, 0);
+        } else if (result == 0) {
+            return std::make_pair(hitPos - pos, literals.matchLongest(text, hitPos, end));
+        } else {
+            Q_ASSERT(result > hitPos - curPos);
+            curPos += result;
+        }
+    }
+}
+
+const SimpleParser::ContentType* SimpleParser::getPrecedingContentType(int precedingContentTypeIndex) const
+{
+    if (precedingContentTypeIndex == AnyContentTypeIndex)
+        return nullptr;
+    return &grammar->data.contentTypes.at(precedingContentTypeIndex);
 }
 
-int SimpleParser::contentCheck(const ContentType& content, int startPos, int length, bool chopWSAfterContent)
+int SimpleParser::contentCheck(const ContentType* content, int startPos, int length, bool chopWSAfterContent)
 {
+    if (!content)
+        return 0;
     int actualLength = length;
     if (actualLength > 0 && chopWSAfterContent) {
-        actualLength -= getWhitespaceTailChopLength(startPos, startPos + length);
+        actualLength -= getWhitespaceTailChopLength(startPos, length);
     }
     // TODO
     Q_UNUSED(content)
@@ -1254,6 +2217,7 @@ int SimpleParser::contentCheck(const ContentType& content, int startPos, int len
 int SimpleParser::findNextStringMatch(int startPos, const QString& str)
 {
     QMap<int, int>& map = state.stringLiteralPositionMap[str];
+    state.touchStringLiteralCache(str);
 
     // remove "expired" entries first
     {
@@ -1261,6 +2225,7 @@ int SimpleParser::findNextStringMatch(int startPos, const QString& str)
         while (iter != map.end()) {
             if (iter.key() < state.curPosition) {
                 iter = map.erase(iter);
+                state.removeCacheEntry(getStringLiteralCacheEntrySize(), false);
             } else {
                 break;
             }
@@ -1272,6 +2237,9 @@ int SimpleParser::findNextStringMatch(int startPos, const QString& str)
     if (iter != map.end()) {
         Q_ASSERT(iter.key() >= startPos);
         if (iter.key() == startPos || (iter.key() > startPos && iter.value() <= startPos)) {
+            if (isProfiling) {
+                getBoundaryProfileRecord(BoundaryType::StringLiteral, str).numCacheHits += 1;
+            }
             if (iter.key() >= state.strLength) {
                 // this mean that the string do not appear in the rest of text
                 return -1;
@@ -1288,10 +2256,17 @@ int SimpleParser::findNextStringMatch(int startPos, const QString& str)
     if (index == -1) {
         key = state.strLength;
     }
+    if (isProfiling) {
+        auto& record = getBoundaryProfileRecord(BoundaryType::StringLiteral, str);
+        record.numSearches += 1;
+        record.numScannedChars += (index == -1)? (state.strLength - startPos) : (index - startPos + str.length());
+    }
     if (iter != map.end() && key == iter.key()) {
         iter.value() = startPos;
     } else {
         map.insert(key, startPos);
+        state.addCacheEntry(getStringLiteralCacheEntrySize());
+        state.enforceCacheLimits(&str, -1);
     }
 
     if (index == -1) {
@@ -1300,13 +2275,18 @@ int SimpleParser::findNextStringMatch(int startPos, const QString& str)
     return index - startPos;
 }
 
-std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegularExpression& regex, QMap<int, std::pair<int, ParseState::RegexMatchData>>& positionMap)
+std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, int regexIndex)
 {
+    const QRegularExpression& regex = state.regexList.at(regexIndex);
+    auto& positionMap = state.regexMatchPositionMap[regexIndex];
+    state.touchRegexCache(regexIndex);
+
     // remove "expired" entries first
     {
         auto iter = positionMap.begin();
         while (iter != positionMap.end()) {
             if (iter.key() < state.curPosition) {
+                state.removeCacheEntry(getRegexCacheEntrySize(iter.value().second), false);
                 iter = positionMap.erase(iter);
             } else {
                 break;
@@ -1319,6 +2299,9 @@ std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegula
     if (iter != positionMap.end()) {
         Q_ASSERT(iter.key() >= startPos);
         if (iter.key() == startPos || (iter.key() > startPos && iter.value().first <= startPos)) {
+            if (isProfiling) {
+                getBoundaryProfileRecord(BoundaryType::Regex, regex.pattern()).numCacheHits += 1;
+            }
             if (iter.key() >= state.strLength) {
                 // this mean that the string do not appear in the rest of text
                 return std::make_pair(-1, 0);
@@ -1330,6 +2313,11 @@ std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegula
 
     // actually do the match
     auto match = regex.match(*state.str, startPos);
+    if (isProfiling) {
+        auto& record = getBoundaryProfileRecord(BoundaryType::Regex, regex.pattern());
+        record.numSearches += 1;
+        record.numScannedChars += match.hasMatch()? (match.capturedEnd() - startPos) : (state.strLength - startPos);
+    }
     if (match.hasMatch()) {
         int startAbsDist = match.capturedStart();
         int length = match.capturedEnd() - startAbsDist;
@@ -1341,12 +2329,16 @@ std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegula
             // new match
             ParseState::RegexMatchData data;
             data.length = length;
-            int numCaptures = regex.captureCount();
-            data.namedCaptures.reserve(numCaptures);
-            for (int i = 0; i < numCaptures; ++i) {
-                data.namedCaptures.push_back(match.capturedRef(i+1));
+            if (state.isRegexCaptureStored.at(regexIndex)) {
+                int numCaptures = regex.captureCount();
+                data.namedCaptures.reserve(numCaptures);
+                for (int i = 0; i < numCaptures; ++i) {
+                    data.namedCaptures.push_back(match.capturedRef(i+1));
+                }
             }
             positionMap.insert(startAbsDist, std::make_pair(startPos, data));
+            state.addCacheEntry(getRegexCacheEntrySize(data));
+            state.enforceCacheLimits(nullptr, regexIndex);
         }
 
         return std::make_pair(startAbsDist - startPos, length);
@@ -1355,6 +2347,8 @@ std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegula
             iter.value().first = startPos;
         } else {
             positionMap.insert(state.strLength, std::make_pair(startPos, ParseState::RegexMatchData()));
+            state.addCacheEntry(getRegexCacheEntrySize(ParseState::RegexMatchData()));
+            state.enforceCacheLimits(nullptr, regexIndex);
         }
         return std::make_pair(-1, 0);
     }
@@ -1364,13 +2358,18 @@ std::pair<int, int> SimpleParser::findNextRegexMatch(int startPos, const QRegula
 std::pair<int, int> SimpleParser::findBoundary_StringLiteral(int pos, const QString& str, int precedingContentTypeIndex, bool chopWSAfterContent)
 {
     if (precedingContentTypeIndex == -1) {
+        if (isProfiling) {
+            auto& record = getBoundaryProfileRecord(BoundaryType::StringLiteral, str);
+            record.numSearches += 1;
+            record.numScannedChars += qMin(str.length(), state.strLength - pos);
+        }
         if (state.str->midRef(pos).startsWith(str)) {
             return std::make_pair(0, str.length());
         }
         return std::make_pair(-1, 0);
     }
 
-    const ContentType& c = data.contentTypes.at(precedingContentTypeIndex);
+    const ContentType* c = getPrecedingContentType(precedingContentTypeIndex);
     int curPos = pos;
     while (true) {
         int dist = findNextStringMatch(curPos, str);
@@ -1397,9 +2396,7 @@ std::pair<int, int> SimpleParser::findBoundary_Regex(int pos, const QString& str
 
 std::pair<int, int> SimpleParser::findBoundary_SpecialCharacter_OptionalWhiteSpace(int pos, int precedingContentTypeIndex, bool chopWSAfterContent)
 {
-    // it seems that if the next character is \n, it will give "no match" result
-    // add workaround here
-    std::pair<int, int> result = findBoundary_Regex_Impl(pos, regexIndex_SpecialCharacter_OptionalWhiteSpace, precedingContentTypeIndex, chopWSAfterContent);
+    std::pair<int, int> result = findBoundary_WhiteSpace_Impl(pos, true, precedingContentTypeIndex, chopWSAfterContent);
     if (result.first == -1) {
         return std::make_pair(0, 0);
     }
@@ -1408,7 +2405,7 @@ std::pair<int, int> SimpleParser::findBoundary_SpecialCharacter_OptionalWhiteSpa
 
 std::pair<int, int> SimpleParser::findBoundary_SpecialCharacter_WhiteSpaces(int pos, int precedingContentTypeIndex, bool chopWSAfterContent)
 {
-    return findBoundary_Regex_Impl(pos, regexIndex_SpecialCharacter_WhiteSpaces, precedingContentTypeIndex, chopWSAfterContent);
+    return findBoundary_WhiteSpace_Impl(pos, false, precedingContentTypeIndex, chopWSAfterContent);
 }
 
 std::pair<int, int> SimpleParser::findBoundary_SpecialCharacter_LineFeed(int pos, int precedingContentTypeIndex, bool chopWSAfterContent)
@@ -1416,11 +2413,58 @@ std::pair<int, int> SimpleParser::findBoundary_SpecialCharacter_LineFeed(int pos
     return findBoundary_StringLiteral(pos, QStringLiteral("\n"), precedingContentTypeIndex, chopWSAfterContent);
 }
 
+std::pair<int, int> SimpleParser::findBoundary_WhiteSpace_Impl(int pos, bool isOptional, int precedingContentTypeIndex, bool chopWSAfterContent)
+{
+    const QChar* text = state.str->constData();
+    int end = state.strLength;
+    // <distance from startPos, length of the white space run>
+    auto findNext = [=](int startPos) -> std::pair<int, int> {
+        int start = isOptional? startPos : grammar->whitespaceClassifier.findNext(text, startPos, end);
+        int length = (start < 0)? 0 : grammar->whitespaceClassifier.runLength(text, start, end);
+        if (isProfiling) {
+            auto& record = getBoundaryProfileRecord(isOptional? BoundaryType::SpecialCharacter_OptionalWhiteSpace : BoundaryType::SpecialCharacter_WhiteSpaces, QString());
+            record.numSearches += 1;
+            record.numScannedChars += (start < 0)? (end - startPos) : (start - startPos + length);
+        }
+        if (start < 0) {
+            return std::make_pair(-1, 0);
+        }
+        return std::make_pair(start - startPos, length);
+    };
+
+    std::pair<int,int> dists = findNext(pos);
+    if (precedingContentTypeIndex == -1) {
+        if (dists.first != 0) {
+            return std::make_pair(-1, 0);
+        } else {
+            return dists;
+        }
+    }
+    if (dists.first == -1) {
+        return std::make_pair(-1, 0);
+    }
+
+    const ContentType* c = getPrecedingContentType(precedingContentTypeIndex);
+    int curPos = pos;
+    while (true) {
+        int result = contentCheck(c, curPos, dists.first, chopWSAfterContent);
+        if (result < 0) {
+            return std::make_pair(-1, 0);
+        } else if (result == 0) {
+            // done
+            return std::make_pair(curPos + dists.first - pos, dists.second);
+        }
+        curPos += result;
+        dists = findNext(curPos);
+        if (dists.first == -1) {
+            return std::make_pair(-1, 0);
+        }
+    }
+}
+
 std::pair<int, int> SimpleParser::findBoundary_Regex_Impl(int pos, int regexIndex, int precedingContentTypeIndex, bool chopWSAfterContent)
 {
-    const QRegularExpression& regex = state.regexList.at(regexIndex);
-    auto& positionMap = state.regexMatchPositionMap[regexIndex];
-    std::pair<int,int> dists = findNextRegexMatch(pos, regex, positionMap);
+    std::pair<int,int> dists = findNextRegexMatch(pos, regexIndex);
     if (precedingContentTypeIndex == -1) {
         if (dists.first != 0) {
             return std::make_pair(-1, 0);
@@ -1429,7 +2473,7 @@ std::pair<int, int> SimpleParser::findBoundary_Regex_Impl(int pos, int regexInde
         }
     }
 
-    const ContentType& c = data.contentTypes.at(precedingContentTypeIndex);
+    const ContentType* c = getPrecedingContentType(precedingContentTypeIndex);
     int firstResult = contentCheck(c, pos, dists.first, chopWSAfterContent);
     if (firstResult < 0) {
         return std::make_pair(-1, 0);
@@ -1440,7 +2484,7 @@ std::pair<int, int> SimpleParser::findBoundary_Regex_Impl(int pos, int regexInde
     // need to loop
     int curPos = pos + firstResult;
     while (true) {
-        std::pair<int,int> curDist = findNextRegexMatch(curPos, regex, positionMap);
+        std::pair<int,int> curDist = findNextRegexMatch(curPos, regexIndex);
         if (curDist.first == -1) {
             return std::make_pair(-1, 0);
         }
@@ -1456,6 +2500,63 @@ std::pair<int, int> SimpleParser::findBoundary_Regex_Impl(int pos, int regexInde
     }
 }
 
+void SimpleParser::setProfilingEnabled(bool enabled)
+{
+    if (enabled && !isProfiling) {
+        isProfiling = true;
+        clearProfileReport();
+    } else {
+        isProfiling = enabled;
+    }
+}
+
+void SimpleParser::clearProfileReport()
+{
+    profileReport = ProfileReport();
+    literalProfileIndex.clear();
+    regexProfileIndex.clear();
+    classifierProfileIndex.clear();
+    patternProfileIndexBase.clear();
+    patternProfileIndexBase.reserve(grammar->data.matchRuleNodes.size());
+    for (const auto& ruleNode : grammar->data.matchRuleNodes) {
+        patternProfileIndexBase.push_back(profileReport.patterns.size());
+        for (int i = 0, n = ruleNode.patterns.size(); i < n; ++i) {
+            ProfileReport::PatternRecord record;
+            record.ruleNodeName = ruleNode.name;
+            record.patternIndex = i;
+            record.typeName = ruleNode.patterns.at(i).typeName;
+            profileReport.patterns.push_back(record);
+        }
+    }
+}
+
+SimpleParser::ProfileReport::BoundaryRecord& SimpleParser::getBoundaryProfileRecord(BoundaryType ty, const QString& str)
+{
+    if (ty == BoundaryType::SpecialCharacter_WhiteSpaces || ty == BoundaryType::SpecialCharacter_OptionalWhiteSpace) {
+        // searched with the whitespace classifier; one record per type
+        auto iter = classifierProfileIndex.find(static_cast<int>(ty));
+        if (iter == classifierProfileIndex.end()) {
+            ProfileReport::BoundaryRecord record;
+            record.ty = ty;
+            record.str = grammar->data.whitespaceList.join(QStringLiteral("|"));
+            iter = classifierProfileIndex.insert(static_cast<int>(ty), profileReport.boundaries.size());
+            profileReport.boundaries.push_back(record);
+        }
+        return profileReport.boundaries[iter.value()];
+    }
+    Q_ASSERT(ty == BoundaryType::StringLiteral || ty == BoundaryType::Regex);
+    QHash<QString, int>& indexMap = (ty == BoundaryType::StringLiteral)? literalProfileIndex : regexProfileIndex;
+    auto iter = indexMap.find(str);
+    if (iter == indexMap.end()) {
+        ProfileReport::BoundaryRecord record;
+        record.ty = ty;
+        record.str = str;
+        iter = indexMap.insert(str, profileReport.boundaries.size());
+        profileReport.boundaries.push_back(record);
+    }
+    return profileReport.boundaries[iter.value()];
+}
+
 // ----------------------------------------------------------------------------
 
 bool SimpleParser::Data::validate(QString& err) const
@@ -13,6 +13,10 @@
 #include <QXmlStreamWriter>
 #include <QRegularExpression>
 #include <QCoreApplication>
+#include <QIODevice>
+#include <QSharedPointer>
+
+#include <functional>
 
 class SimpleParser
 {
@@ -139,6 +143,18 @@ public:
         bool validate(QString& err) const;
     };
 
+    // memory budget for the match position caches in ParseState
+    // once the estimated size goes over the budget, whole caches (one per literal / regex) are dropped in LRU order
+    struct MatchCacheOptions {
+        qint64 memoryBudget = 0; // estimated bytes; 0 for unlimited
+        int maxEntriesPerCache = 0; // 0 for unlimited; entries farthest from the current position are dropped first
+    };
+    struct MatchCacheStatistics {
+        qint64 peakNumEntries = 0;
+        qint64 peakEstimatedSize = 0; // in bytes
+        qint64 numEvictedEntries = 0; // entries dropped by the budget or the per-cache limit (expired ones are not counted)
+    };
+
     struct ParseState {
         const QString* str = nullptr;
         EventLogger* logger = nullptr;
@@ -157,9 +173,37 @@ public:
         int strLength = 0;
         int curPosition = 0;
 
+        // bookkeeping for the cache budget
+        MatchCacheOptions cacheOptions;
+        MatchCacheStatistics cacheStatistics; // reset in set(); kept by clear() so that it can be read after parsing
+        qint64 numCacheEntries = 0;
+        qint64 estimatedCacheSize = 0;
+        quint64 cacheUseTick = 0;
+        QHash<QString, quint64> stringLiteralLastUse;
+        QVector<quint64> regexLastUse; // [regex index]
+        QVector<bool> isRegexCaptureStored; // [regex index]; captures are only kept for regexes whose captures are exported
+        // last literal scan of each class-based boundary: <search start, first position with a literal (-1 if none)>
+        QVector<std::pair<int, int>> classBasedSearchMemo; // [named boundary index]
+
         void clear();
         void set(const QString& text, EventLogger* loggerArg);
         int getRegexIndex(const QString& pattern);
+
+        // recency is only tracked when there is a budget
+        void touchStringLiteralCache(const QString& literal) {
+            if (cacheOptions.memoryBudget > 0) {
+                stringLiteralLastUse[literal] = ++cacheUseTick;
+            }
+        }
+        void touchRegexCache(int regexIndex) {
+            if (cacheOptions.memoryBudget > 0) {
+                regexLastUse[regexIndex] = ++cacheUseTick;
+            }
+        }
+        void addCacheEntry(qint64 size);
+        void removeCacheEntry(qint64 size, bool isEvicted);
+        // apply MatchCacheOptions after an insertion to the given cache; the cache in use is never dropped as a whole
+        void enforceCacheLimits(const QString* literal, int regexIndex);
     };
 
     struct PatternMatchFailAttempts {
@@ -169,48 +213,174 @@ public:
         QVector<TextUtil::PlainTextLocation> elementMatchPosVec;
     };
 
+    // options for streaming parsing
+    struct StreamingOptions {
+        int windowSize = 1 << 20; // number of characters read from device per window
+        int lookaheadSize = 1 << 16; // number of characters that must be available after current position before a match is attempted
+        QByteArray codecName = QByteArrayLiteral("UTF-8"); // UTF-16 input with BOM is detected automatically
+    };
+
+    // the engine used for testing a pattern at a position
+    enum class PatternEngine : int {
+        HoleFilling, // tryPattern: solves the elements in tiers (boundaries, whitespaces, contents)
+        Sequential // tryPattern_v1: matches the elements from left to right
+    };
+
+    // opt-in profiling data for finding the patterns and boundaries that make parsing slow
+    struct ProfileReport {
+        struct PatternRecord {
+            QString ruleNodeName;
+            int patternIndex = -1;
+            QString typeName; // empty for early exit patterns
+            qint64 numAttempts = 0;
+            qint64 numSuccesses = 0;
+            qint64 totalTimeNs = 0;
+            qint64 numSearchEntries = 0; // entries created in the depth-first search of tryPattern
+        };
+        struct BoundaryRecord {
+            // StringLiteral, Regex, or SpecialCharacter_(Optional)WhiteSpace for searches by the whitespace classifier;
+            // line feeds are reported as string literals
+            BoundaryType ty = BoundaryType::StringLiteral;
+            QString str; // the whitespaces joined by '|' for classifier searches
+            qint64 numSearches = 0; // searches actually performed on the text
+            qint64 numCacheHits = 0; // searches answered by the position maps
+            qint64 numScannedChars = 0;
+        };
+        QVector<PatternRecord> patterns;
+        QVector<BoundaryRecord> boundaries;
+        qint64 numParses = 0;
+        qint64 totalParseTimeNs = 0;
+        qint64 totalParsedChars = 0;
+        MatchCacheStatistics cache; // peaks are the maximum over all parses; evictions are summed
+    };
+
+    // the compiled grammar; see the definition below
+    class Grammar;
+    using GrammarPointer = QSharedPointer<const Grammar>;
+
 public:
     explicit SimpleParser(const Data& d);
+
+    // a parser on an already compiled grammar; nothing in the grammar is copied
+    // parsers sharing a grammar can run on different threads at the same time
+    explicit SimpleParser(const GrammarPointer& grammarArg);
+    const GrammarPointer& getGrammar() const {return grammar;}
+
     bool performParsing(const QString& src, Tree& dest, EventLogger* logger = nullptr);
 
+    // also output the text range of each node (indexed by node index in dest)
+    // for non-root nodes, it is the range consumed by the pattern creating the node; the root covers the whole text
+    bool performParsing(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>& nodeTextRanges, EventLogger* logger = nullptr);
+
+    /**
+     * @brief performIncrementalParsing reparse the text after an edit, reusing the result of last parse
+     *
+     * Parsing resumes from the last top-level node starting before the edit. Once a new top-level node matches an old
+     * top-level node after the edit (same type, keys, values and shifted text range), the remaining old nodes are spliced back without parsing.
+     * The result is the same as performParsing as long as parsing of a top-level node does not depend on text after the next top-level node.
+     *
+     * @param src the text after the edit
+     * @param editStart the position of the edit
+     * @param removedLength number of characters removed from old text at editStart
+     * @param insertedLength number of characters inserted at editStart in src
+     * @param oldTree the tree from a successful parse of old text
+     * @param oldNodeTextRanges the node text ranges of the old tree
+     * @return true if parsing succeeds
+     */
+    bool performIncrementalParsing(const QString& src, int editStart, int removedLength, int insertedLength,
+                                   const Tree& oldTree, const QVector<TextUtil::PlainTextLocation>& oldNodeTextRanges,
+                                   Tree& dest, QVector<TextUtil::PlainTextLocation>& destNodeTextRanges);
+
+    /**
+     * @brief performStreamingParsing parse text from a device without holding the whole text in memory
+     *
+     * Each top-level node (a direct child of the root) is handed to the callback as soon as its last frame is popped,
+     * i.e. when no more children can be added to it, or when the input ends. The tree passed to the callback has the same shape as the one from performParsing,
+     * except that the root only contains that single top-level node. The callback can swap the tree out.
+     * Only text of the current record and the lookahead are kept, so memory is bounded by the largest top-level record.
+     * Boundaries for a match must be found within lookaheadSize characters, otherwise the result can differ from performParsing.
+     *
+     * @param src the device to read from; must be opened for reading
+     * @param recordCallback the callback for each top-level record; return false to stop parsing
+     * @return true if the whole input is consumed, false if parsing failed, reading failed, or is stopped by the callback
+     */
+    bool performStreamingParsing(QIODevice* src, std::function<bool(Tree&)> recordCallback, const StreamingOptions& options);
+    bool performStreamingParsing(QIODevice* src, std::function<bool(Tree&)> recordCallback) {
+        return performStreamingParsing(src, recordCallback, StreamingOptions());
+    }
+
     // returns a string in the form of e.g. ( |\t|\u3000)
     static QString getWhiteSpaceRegexPattern(const QStringList& whiteSpaceList);
 
-private:
-    // All persistent data should be in Data
-    Data data;
+    // the budget applies from the next parse; statistics are for the last parse
+    void setMatchCacheOptions(const MatchCacheOptions& options) {state.cacheOptions = options;}
+    const MatchCacheOptions& getMatchCacheOptions() const {return state.cacheOptions;}
+    const MatchCacheStatistics& getMatchCacheStatistics() const {return state.cacheStatistics;}
+
+    // the engine applies from the next parse; both engines should produce the same tree
+    void setPatternEngine(PatternEngine engine) {patternEngine = engine;}
+    PatternEngine getPatternEngine() const {return patternEngine;}
+
+    // untraced parsing skips patterns by literal prefix and matches literal-only patterns directly;
+    // disable it to compare traced and untraced parsing on the same code path
+    void setUntracedFastPathEnabled(bool enabled) {isUntracedFastPathEnabled = enabled;}
+    bool getUntracedFastPathEnabled() const {return isUntracedFastPathEnabled;}
+
+    // profiling; the report accumulates across parses until it is cleared
+    void setProfilingEnabled(bool enabled);
+    bool isProfilingEnabled() const {return isProfiling;}
+    void clearProfileReport();
+    const ProfileReport& getProfileReport() const {return profileReport;}
 
 private:
     // helper functions
 
+    // take the regular expressions from the grammar
+    void initializeState();
+
+    struct PartialParseState;
+    bool performParsingImpl(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>* nodeTextRanges, EventLogger* logger, PartialParseState* stream);
+
+    // IsTraced: whether events are logged; the untraced variant does not allocate anything for diagnostics
+    template <bool IsTraced>
+    bool performParsingVariant(const QString& src, Tree& dest, QVector<TextUtil::PlainTextLocation>* nodeTextRanges, EventLogger* logger, PartialParseState* stream);
+
     /**
      * @brief findBoundary find the specified boundary from the given position of text
      * @param text the input string
      * @param decl the boundary to search for
-     * @param precedingContentTypeIndex the type index of content that precedes the boundary; -1 if no content is accepted at current position
+     * @param precedingContentTypeIndex the type index of content that precedes the boundary; -1 if no content is accepted at current position,
+     *        AnyContentTypeIndex to search forward for the first occurrence without checking the skipped text
      * @param chopWSAfterContent whether there is a whitespace pattern after content, making it required to chop off whitespaces
      * @return a pair: <match start index (offset from current head of text), match length>. return (-1, 0) if there is no match
      */
     std::pair<int, int> findBoundary(int pos, const BoundaryDeclaration& decl, int precedingContentTypeIndex, bool chopWSAfterContent);
+    static constexpr int AnyContentTypeIndex = -2;
+    // nullptr for AnyContentTypeIndex
+    const ContentType* getPrecedingContentType(int precedingContentTypeIndex) const;
 
 
     std::pair<int, int> findBoundary_StringLiteral(int pos, const QString& str, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_Regex(int pos, const QString& str, int precedingContentTypeIndex, bool chopWSAfterContent);
+    std::pair<int, int> findBoundary_WhiteSpace_Impl(int pos, bool isOptional, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_Regex_Impl(int pos, int regexIndex, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_SpecialCharacter_OptionalWhiteSpace(int pos, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_SpecialCharacter_WhiteSpaces(int pos, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_SpecialCharacter_LineFeed(int pos, int precedingContentTypeIndex, bool chopWSAfterContent);
     std::pair<int, int> findBoundary_ClassBased(int pos, int boundaryIndex, int precedingContentTypeIndex, bool chopWSAfterContent);
+    struct LiteralPrefixTrie;
+    std::pair<int, int> findBoundary_ClassBasedLiterals(int pos, int boundaryIndex, const LiteralPrefixTrie& literals, int precedingContentTypeIndex, bool chopWSAfterContent);
 
     int findNextStringMatch(int startPos, const QString& str);
-    std::pair<int, int> findNextRegexMatch(int startPos, const QRegularExpression& regex, QMap<int, std::pair<int, ParseState::RegexMatchData> > &positionMap);
+    std::pair<int, int> findNextRegexMatch(int startPos, int regexIndex);
 
     // incremental check (this function would be called on pieces of contents)
     // return -1 if check fails, 0 if passes, positive distance (ret > length) if the content must be extended
-    int contentCheck(const ContentType& content, int startPos, int length, bool chopWSAfterContent);
+    // content can be nullptr, in which case everything passes
+    int contentCheck(const ContentType* content, int startPos, int length, bool chopWSAfterContent);
 
     // for the substring, what's the length of whitespace in the tail
-    int getWhitespaceTailChopLength(int startPos, int endPos);
+    int getWhitespaceTailChopLength(int startPos, int length);
 
     struct PatternMatchResult {
         TreeBuilder::Node* node = nullptr;
@@ -243,35 +413,146 @@ private:
     // the up-to-date entry function for testing a pattern
     PatternMatchResult tryPattern(const Pattern& pattern, int pos, int patternTestSourceEvent);
 
+    template <bool IsTraced>
+    PatternMatchResult tryPatternVariant(const Pattern& pattern, int pos, int patternTestSourceEvent);
+
+    // patterns that start with string literals (or line feeds) can only match if the text starts with the concatenation of them
+    // if the rest of the pattern is empty or a single content, the match is fully determined by the prefix
+    struct LiteralPatternInfo {
+        QString prefix;
+        int numPrefixElements = 0;
+        bool isLiteralOnly = false;
+    };
+
+    // match a pattern with isLiteralOnly set without going through the search in tryPattern; same result as tryPattern
+    PatternMatchResult tryLiteralPattern(const Pattern& pattern, const LiteralPatternInfo& info, int pos);
+
 private:
-    // "volatile" data that can be recomputed or ones that are just cache
+    // a trie over literal prefixes of all patterns in a pass
+    // one walk from the current position tells which patterns can possibly match
+    struct LiteralPrefixTrie {
+        struct Node {
+            QVector<std::pair<QChar, int>> edges; // sorted by character
+            QVector<int> terminals; // ordinals of patterns whose prefix ends at this node
+        };
+        QVector<Node> nodes; // root is at index 0
+        int numPatterns = 0;
+
+        void addPrefix(const QString& prefix, int ordinal);
+        // set isCandidate[ordinal] for all patterns whose prefix appears at pos
+        void match(const QString& text, int pos, std::vector<char>& isCandidate) const;
+        // length of the longest prefix that appears at pos and ends no later than end; -1 if none
+        int matchLongest(const QChar* text, int pos, int end) const;
+    };
 
-    // derived helper data
-    QHash<QString, int> boundaryNameToIndexMap;
-    QHash<QString, int> contentTypeNameToIndexMap;
-    QHash<int, QVector<int>> classBasedBoundaryChildList;
+    // a class-based boundary with the elements of all its children (and class-based boundaries it references) flattened
+    // string literals and line feeds are found together in one scan; other elements are searched one by one
+    struct ClassBasedMatcher {
+        LiteralPrefixTrie literals; // no nodes if there is no literal
+        QVector<BoundaryDeclaration> otherElements;
+    };
+
+    // matches entries of Data::whitespaceList without regular expressions
+    // entries of a single code unit are looked up in a bitmap; longer ones (e.g. surrogate pairs) go through small tries
+    struct WhiteSpaceClassifier {
+        struct TrieNode {
+            QVector<std::pair<QChar, int>> edges; // sorted by character
+            bool isTerminal = false;
+        };
+        std::vector<quint32> singleUnitBitmap; // one bit per BMP code unit
+        QVector<TrieNode> forwardTrie; // multi-unit entries; root is at index 0
+        QVector<TrieNode> backwardTrie; // same entries, reversed
+
+        void build(const QStringList& whitespaceList);
+        bool isSingleUnitWhiteSpace(QChar c) const {
+            ushort u = c.unicode();
+            return (singleUnitBitmap[u >> 5] >> (u & 31)) & 1u;
+        }
+        // length of the longest entry starting at pos and ending no later than end; 0 if none
+        int matchForward(const QChar* str, int pos, int end) const;
+        // length of the longest entry ending at end and starting no earlier than start; 0 if none
+        int matchBackward(const QChar* str, int start, int end) const;
+        // total length of consecutive entries starting at pos
+        int runLength(const QChar* str, int pos, int end) const;
+        // position of the first entry in [pos, end), or -1 if there is none
+        int findNext(const QChar* str, int pos, int end) const;
+
+    private:
+        static void addToTrie(QVector<TrieNode>& nodes, const QString& str, bool isReversed);
+        // walk from pos towards limit (exclusive) by step; returns the length of the longest entry reached
+        static int walkTrie(const QVector<TrieNode>& nodes, const QChar* str, int pos, int limit, int step);
+    };
 
     // for match rule nodes, there will be a pseudo root node created
     // the pseudo root (match rule) node will have index of d.matchRuleNodes.size()
     struct MatchPassData {
         QHash<int, QVector<int>> patterns; // ruleNodeIndex -> patternIndices
         int pass = 0;
+        LiteralPrefixTrie prefixTrie; // pattern ordinals follow the iteration order of patterns
     };
     using ContextMatchRuleData = QVector<MatchPassData>;
-    QVector<ContextMatchRuleData> childNodeMatchRules;
-    const int rootNodeRuleIndex = 0;
-    // for now, white space related special character search is done by regular expressions
-    int regexIndex_SpecialCharacter_OptionalWhiteSpace = -1;
-    int regexIndex_SpecialCharacter_WhiteSpaces = -1;
-    // line feed search is done by string literal
 
-    // empty line skip is done using dedicated regex
-    QRegularExpression emptyLineRegex;
+public:
+    // everything derived from Data that stays the same across parses
+    // a grammar is never modified after construction, so it can be shared by any number of parsers on any threads
+    class Grammar {
+    public:
+        explicit Grammar(const Data& d);
+
+        const Data& getData() const {return data;}
+
+    private:
+        friend class SimpleParser;
+
+        // populate the derived helper data from data
+        void compile();
+        void buildPrefixTries();
+        void buildClassBasedMatchers();
+        void prepareRegexes();
+
+        // All persistent data should be in Data
+        Data data;
+
+        // derived helper data
+        QHash<QString, int> boundaryNameToIndexMap;
+        QHash<QString, int> contentTypeNameToIndexMap;
+        QHash<int, QVector<int>> classBasedBoundaryChildList;
+        QHash<int, ClassBasedMatcher> classBasedMatchers; // built after compiling
+        QVector<ContextMatchRuleData> childNodeMatchRules;
+        // white space related special character search, empty line skip and tail chop all use the classifier
+        // line feed search is done by string literal
+        WhiteSpaceClassifier whitespaceClassifier;
+
+        QVector<QVector<LiteralPatternInfo>> literalPatternInfo; // [match rule node index][pattern index]
+        QStringList grammarRegexPatterns; // all regular expressions used in the grammar; compiled ahead of parsing
+
+        // compiled (and optimized) regexes of grammarRegexPatterns; copies in ParseState share the compiled pattern
+        QList<QRegularExpression> regexList;
+        QHash<QString, int> regexPatternToIndexMap;
+        QVector<bool> isRegexCaptureStored; // [regex index]
+    };
+
+private:
+    GrammarPointer grammar;
+    const int rootNodeRuleIndex = 0;
+    std::vector<char> prefixCandidates; // scratch buffer for LiteralPrefixTrie::match()
 
     // runtime data
     ParseState state;
     TreeBuilder builder;
 
+    PatternEngine patternEngine = PatternEngine::HoleFilling;
+    bool isUntracedFastPathEnabled = true;
+
+    // profiling data
+    bool isProfiling = false;
+    int currentProfilePattern = -1; // index in profileReport.patterns of the pattern being tried
+    ProfileReport profileReport;
+    QVector<int> patternProfileIndexBase; // [match rule node index] -> index of its first pattern in profileReport.patterns
+    QHash<QString, int> literalProfileIndex; // literal -> index in profileReport.boundaries
+    QHash<QString, int> regexProfileIndex; // regex pattern -> index in profileReport.boundaries
+    QHash<int, int> classifierProfileIndex; // whitespace boundary type -> index in profileReport.boundaries
+    ProfileReport::BoundaryRecord& getBoundaryProfileRecord(BoundaryType ty, const QString& str);
 };
 
 // making it usable in QVariant
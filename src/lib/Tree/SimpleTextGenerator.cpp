@@ -18,40 +18,32 @@ SimpleTextGenerator::SimpleTextGenerator(const Data &d)
 
 bool SimpleTextGenerator::generationImpl(const Tree& src, QString& dest, int nodeIndex) const
 {
-    const Tree::Node& node = src.getNode(nodeIndex);
-    QString canonicalName = aliasToCanonicalNameMap.value(node.typeName, node.typeName);
-    auto iter = data.expansions.find(canonicalName);
-    if (iter != data.expansions.end()) {
-        // we find the rule
-        const NodeExpansionRule& rule = iter.value();
-        if (!writeFragment(dest, node, rule.header, data.evalFailPolicy)) {
-            return false;
-        }
-        bool isFirst = true;
-        for (int childOffset : node.offsetToChildren) {
-            if (!isFirst) {
-                if (!writeFragment(dest, node, rule.delimiter, data.evalFailPolicy)) {
-                    return false;
-                }
-            } else {
-                isFirst = false;
-            }
-            if (!generationImpl(src, dest, nodeIndex + childOffset)) {
+    // walk over an explicit stack so that deep trees do not overflow the call stack
+    struct Frame {
+        int nodeIndex;
+        int nextChild; // index in offsetToChildren
+        const NodeExpansionRule* rule; // null for default expansion of unknown nodes
+    };
+    QVector<Frame> stack;
+
+    // write the header (if any) and push the node for visiting its children; false if generation should fail
+    auto enterNode = [&](int index) -> bool {
+        const Tree::Node& node = src.getNode(index);
+        QString canonicalName = aliasToCanonicalNameMap.value(node.typeName, node.typeName);
+        auto iter = data.expansions.find(canonicalName);
+        if (iter != data.expansions.end()) {
+            // we find the rule
+            const NodeExpansionRule& rule = iter.value();
+            if (!writeFragment(dest, node, rule.header, data.evalFailPolicy)) {
                 return false;
             }
+            stack.push_back(Frame{index, 0, &rule});
+            return true;
         }
-        if (!writeFragment(dest, node, rule.tail, data.evalFailPolicy)) {
-            return false;
-        }
-    } else {
         // no rules found
         switch (data.unknownNodePolicy) {
         case UnknownNodePolicy::DefaultExpand: {
-            for (int childOffset : node.offsetToChildren) {
-                if (!generationImpl(src, dest, nodeIndex + childOffset)) {
-                    return false;
-                }
-            }
+            stack.push_back(Frame{index, 0, nullptr});
             return true;
         }
         case UnknownNodePolicy::Ignore: {
@@ -61,6 +53,35 @@ bool SimpleTextGenerator::generationImpl(const Tree& src, QString& dest, int nod
             return false;
         }
         }
+        return true;
+    };
+
+    if (!enterNode(nodeIndex)) {
+        return false;
+    }
+    while (!stack.isEmpty()) {
+        Frame& frame = stack.last();
+        const Tree::Node& node = src.getNode(frame.nodeIndex);
+        if (frame.nextChild < node.offsetToChildren.size()) {
+            if (frame.rule && frame.nextChild > 0) {
+                if (!writeFragment(dest, node, frame.rule->delimiter, data.evalFailPolicy)) {
+                    return false;
+                }
+            }
+            int childIndex = frame.nodeIndex + node.offsetToChildren.at(frame.nextChild);
+            frame.nextChild += 1;
+            // frame is invalidated from here
+            if (!enterNode(childIndex)) {
+                return false;
+            }
+        } else {
+            if (frame.rule) {
+                if (!writeFragment(dest, node, frame.rule->tail, data.evalFailPolicy)) {
+                    return false;
+                }
+            }
+            stack.pop_back();
+        }
     }
     return true;
 }
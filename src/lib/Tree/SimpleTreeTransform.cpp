@@ -1,50 +1,534 @@
 #include "src/lib/Tree/SimpleTreeTransform.h"
 #include "src/utils/NameSorting.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#ifdef PP_ENABLE_THREADS
+#include "src/utils/FunctionRunnable.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+#endif
+
+#include <algorithm>
+#include <vector>
 
 namespace {
-void performTransformImpl(
+// a subtree whose transformation is deferred to a (possibly parallel) task
+struct DeferredSubtree {
+    int srcNodeIndex = -1;
+    int depth = 0;
+    int parent = -1; // index of output node where the output of the subtree is attached
+};
+
+// errors of a pass, recorded as requested by TransformOptions
+struct ErrorSink {
+    using ErrorRecording = SimpleTreeTransform::TransformOptions::ErrorRecording;
+    ErrorRecording recording = ErrorRecording::All;
+    bool isRecorded = true; // false if nobody reads the errors
+    int numErrors = 0;
+    QVector<SimpleTreeTransform::TransformError> errors;
+
+    void add(SimpleTreeTransform::TransformError& err) {
+        ++numErrors;
+        if (!isRecorded || (recording == ErrorRecording::FirstOnly && !errors.isEmpty())) {
+            return;
+        }
+        if (recording == ErrorRecording::CodeOnly) {
+            err.evalFailData.key.clear();
+            err.evalFailData.value.clear();
+            err.unrecognizedNodeType.clear();
+        }
+        errors.push_back(err);
+    }
+
+    void append(const ErrorSink& other) {
+        numErrors += other.numErrors;
+        errors.append(other.errors);
+    }
+
+    bool isEmpty() const {return numErrors == 0;}
+};
+
+// counters of a pass while profiling
+struct ProfileCounters {
+    QVector<SimpleTreeTransform::TransformProfile::RuleEntry> rules; // by rule id
+    qint64 numDefaultAction = 0;
+    qint64 numUnrecognizedAction = 0;
+    qint64 numSkipped = 0;
+
+    ProfileCounters& operator+=(const ProfileCounters& rhs) {
+        Q_ASSERT(rules.size() == rhs.rules.size());
+        for (int i = 0, n = rules.size(); i < n; ++i) {
+            rules[i] += rhs.rules.at(i);
+        }
+        numDefaultAction += rhs.numDefaultAction;
+        numUnrecognizedAction += rhs.numUnrecognizedAction;
+        numSkipped += rhs.numSkipped;
+        return *this;
+    }
+};
+
+// empty counters for all rules; rule ids are assigned in the order of rule lists
+ProfileCounters makeProfileCounters(const QVector<QVector<SimpleTreeTransform::NodeTransformRule>>& ruleLists)
+{
+    ProfileCounters result;
+    for (const auto& ruleList : ruleLists) {
+        for (const auto& rule : ruleList) {
+            SimpleTreeTransform::TransformProfile::RuleEntry entry;
+            entry.numPredicateFailures.fill(0, rule.predicates.size());
+            result.rules.push_back(entry);
+        }
+    }
+    return result;
+}
+
+// state of one walk over (part of) the source tree
+struct TransformPass {
+    const SimpleTreeTransform::Data& transform;
+    const QVector<QVector<SimpleTreeTransform::NodeTransformRule>>& ruleLists;
+    const QVector<int>& nodeRuleListIndex;
+    Tree::EvaluationContext ctx;
+    PreOrderTreeBuilder& builder;
+    // shared by all passes over the same source tree; a pass only writes entries inside the subtree it walks
+    // empty if no rule skips nodes
+    QVector<int>& skipSrcVec;
+    bool isProvenanceRecorded = true;
+    QVector<SimpleTreeTransform::NodeProvenance> provenanceVec;
+    ErrorSink errors;
+    // children at this depth are recorded in deferred instead of being visited; -1 to visit everything
+    int partitionDepth = -1;
+    QVector<DeferredSubtree> deferred;
+    // evaluation order of predicates for each rule, and the id of the first predicate of each rule
+    const QVector<QVector<QVector<int>>>* predicateOrder = nullptr;
+    const QVector<QVector<int>>* predicateIdBase = nullptr;
+    // statistics by predicate id; null if they are not collected
+    QVector<SimpleTreeTransform::PredicateStatistics::Entry>* predicateCounters = nullptr;
+    // null if not profiling
+    ProfileCounters* profileCounters = nullptr;
+    const QVector<int>* ruleIdBase = nullptr;
+
+    TransformPass(const SimpleTreeTransform::Data& transformArg,
+                  const QVector<QVector<SimpleTreeTransform::NodeTransformRule>>& ruleListsArg,
+                  const QVector<int>& nodeRuleListIndexArg,
+                  const Tree& tree,
+                  const QList<const Tree*>& sideTreeList,
+                  PreOrderTreeBuilder& builderArg,
+                  QVector<int>& skipSrcVecArg)
+        : transform(transformArg),
+          ruleLists(ruleListsArg),
+          nodeRuleListIndex(nodeRuleListIndexArg),
+          ctx(tree, sideTreeList, 0),
+          builder(builderArg),
+          skipSrcVec(skipSrcVecArg)
+    {}
+};
+
+using TransformType = SimpleTreeTransform::NodeTransformRule::TransformType;
+
+void setNodeData(Tree::Node& dest, const Tree::Node& src)
+{
+    dest.typeName = src.typeName;
+    dest.keyList = src.keyList;
+    dest.valueList = src.valueList;
+}
+
+void moveNodeData(Tree::Node& dest, Tree::Node& src)
+{
+    dest.typeName.swap(src.typeName);
+    dest.keyList.swap(src.keyList);
+    dest.valueList.swap(src.valueList);
+}
+
+// evaluates expressions on the current node of a pass
+struct ContextEvaluator {
+    const Tree::EvaluationContext& ctx;
+
+    bool predicate(const Tree::Predicate& pred, bool& isGood) const {
+        return Tree::evaluatePredicate(pred, isGood, ctx);
+    }
+    QString value(const Tree::GeneralValueExpression& expr, bool& isGood) const {
+        return Tree::evaluateGeneralValueExpression(expr, isGood, ctx);
+    }
+};
+
+// evaluates expressions of local transforms on a node that need not be in a tree
+// same result as Tree::evaluate*() for expressions without traversal
+struct LocalEvaluator {
+    const Tree::Node& node;
+
+    QString singleValue(const Tree::SingleValueExpression& expr, bool& isGood) const {
+        Q_ASSERT(expr.traversal.isEmpty() && expr.treeIndex == -1);
+        Q_ASSERT(expr.es != Tree::SingleValueExpression::EvaluateStrategy::TraverseOnly);
+        return Tree::evaluateLocalValueExpression(node, expr.defaultValue, isGood);
+    }
+    bool predicate(const Tree::Predicate& pred, bool& isGood) const {
+        Q_ASSERT(pred.ty == Tree::Predicate::PredicateType::ValueEqual);
+        QString lhs = singleValue(pred.v1, isGood);
+        if (!isGood)
+            return false;
+        QString rhs = singleValue(pred.v2, isGood);
+        if (!isGood)
+            return false;
+        bool result = (lhs == rhs);
+        return (pred.isInvert? !result : result);
+    }
+    QString value(const Tree::GeneralValueExpression& expr, bool& isGood) const {
+        for (const auto& p : expr.branches) {
+            bool isFailed = false;
+            for (const auto& pred : p.predicates) {
+                bool isPredGood = false;
+                if (!predicate(pred, isPredGood) || !isPredGood) {
+                    isFailed = true;
+                    break;
+                }
+            }
+            if (isFailed)
+                continue;
+
+            QString result = singleValue(p.value, isGood);
+            if (!isGood)
+                continue;
+
+            return result;
+        }
+        isGood = false;
+        return QString();
+    }
+};
+
+// one in this many evaluations of a predicate is timed
+const qint64 PREDICATE_TIMING_INTERVAL = 64;
+
+// evaluate a predicate and update its statistics
+template <typename Evaluator>
+bool evaluateCountedPredicate(const Tree::Predicate& pred, const Evaluator& eval, SimpleTreeTransform::PredicateStatistics::Entry& entry)
+{
+    bool isGood = false;
+    bool isPassed = false;
+    if (entry.numEvaluated % PREDICATE_TIMING_INTERVAL == 0) {
+        QElapsedTimer timer;
+        timer.start();
+        isPassed = eval.predicate(pred, isGood) && isGood;
+        entry.totalTimeNs += timer.nsecsElapsed();
+        entry.numTimed += 1;
+    } else {
+        isPassed = eval.predicate(pred, isGood) && isGood;
+    }
+    entry.numEvaluated += 1;
+    if (isPassed) {
+        entry.numPassed += 1;
+    }
+    return isPassed;
+}
+
+// the first rule whose predicates are all satisfied; null if there is none
+// predicates of a rule are ANDed, so they can be evaluated in any order (given by predicateOrder if not null)
+// predicateCounters (if not null) is indexed by predicate id, starting from predicateIdBase of each rule
+// ruleCounters (if not null) points to the profile entries of rules in ruleList
+template <typename Evaluator>
+const SimpleTreeTransform::NodeTransformRule* selectPattern(
+        const QVector<SimpleTreeTransform::NodeTransformRule>& ruleList,
+        const Evaluator& eval,
+        int& patternIndex,
+        const QVector<QVector<int>>* predicateOrder = nullptr,
+        const QVector<int>* predicateIdBase = nullptr,
+        QVector<SimpleTreeTransform::PredicateStatistics::Entry>* predicateCounters = nullptr,
+        SimpleTreeTransform::TransformProfile::RuleEntry* ruleCounters = nullptr)
+{
+    for (int i = 0, n = ruleList.size(); i < n; ++i) {
+        const auto& pattern = ruleList.at(i);
+        const QVector<int>* order = predicateOrder? &predicateOrder->at(i) : nullptr;
+        QElapsedTimer timer;
+        if (ruleCounters) {
+            timer.start();
+        }
+        bool isAnyPredicateFailed = false;
+        int failedPredicate = -1;
+        for (int j = 0, numPredicates = pattern.predicates.size(); j < numPredicates; ++j) {
+            int predIndex = order? order->at(j) : j;
+            const auto& pred = pattern.predicates.at(predIndex);
+            bool isPassed = false;
+            if (predicateCounters) {
+                isPassed = evaluateCountedPredicate(pred, eval, (*predicateCounters)[predicateIdBase->at(i) + predIndex]);
+            } else {
+                bool isGood = false;
+                isPassed = eval.predicate(pred, isGood) && isGood;
+            }
+            if (!isPassed) {
+                isAnyPredicateFailed = true;
+                failedPredicate = predIndex;
+                break;
+            }
+        }
+        if (ruleCounters) {
+            SimpleTreeTransform::TransformProfile::RuleEntry& entry = ruleCounters[i];
+            entry.predicateTimeNs += timer.nsecsElapsed();
+            entry.numEvaluated += 1;
+            if (isAnyPredicateFailed) {
+                entry.numPredicateFailures[failedPredicate] += 1;
+            } else {
+                entry.numMatched += 1;
+            }
+        }
+        if (!isAnyPredicateFailed) {
+            patternIndex = i;
+            return &pattern;
+        }
+    }
+    patternIndex = -1;
+    return nullptr;
+}
+
+// decision for a node without matching pattern
+TransformType getPredefinedDecision(
         const SimpleTreeTransform::Data& transform,
-        const Tree& tree,
-        TreeBuilder& builder,
-        const QList<const Tree*>& sideTreeList,
-        QVector<int>& skipSrcVec,
-        QVector<SimpleTreeTransform::NodeProvenance>& provenanceVec,
-        QVector<SimpleTreeTransform::TransformError>& errors,
+        bool isNodeTypeRecognized,
         int startNode,
-        TreeBuilder::Node* parent)
+        const QString& typeName,
+        ErrorSink& errors)
 {
-    Q_ASSERT(sideTreeList.size() == transform.sideTreeNameList.size());
-    const Tree::Node& node = tree.getNode(startNode);
-    int patternIndex = -1;
-    const SimpleTreeTransform::NodeTransformRule* patternPtr = nullptr;
-    Tree::EvaluationContext ctx(tree, sideTreeList, startNode);
-    bool isRemovedBecauseSkipped = (skipSrcVec.at(startNode) >= 0);
-    bool isNodeTypeRecognized = false;
-    if (!isRemovedBecauseSkipped) {
-        auto iter = transform.nodeTypeToRuleList.find(node.typeName);
-        if (iter != transform.nodeTypeToRuleList.end()) {
-            isNodeTypeRecognized = true;
-            for (int i = 0, n = iter.value().size(); i < n; ++i) {
-                const auto& pattern = iter.value().at(i);
-                bool isAnyPredicateFailed = false;
-                for (const auto& pred : pattern.predicates) {
-                    bool isGood = false;
-                    if (!(Tree::evaluatePredicate(pred, isGood, ctx) && isGood)) {
-                        isAnyPredicateFailed = true;
-                        break;
+    SimpleTreeTransform::PredefinedAction act = transform.defaultAction;
+    if (!isNodeTypeRecognized && !transform.isUnrecognizedNodeUseDefaultAction) {
+        act = transform.unrecognizedNodeActionOverride;
+    }
+    switch (act) {
+    case SimpleTreeTransform::PredefinedAction::PassThrough:
+        return TransformType::PassThrough;
+    case SimpleTreeTransform::PredefinedAction::Remove:
+        return TransformType::Remove;
+    case SimpleTreeTransform::PredefinedAction::Error: {
+        SimpleTreeTransform::TransformError err;
+        err.srcNodeIndex = startNode;
+        err.patternIndex = -1;
+        if (isNodeTypeRecognized) {
+            err.cause = SimpleTreeTransform::TransformError::Cause::RequestedError_DefaultActionForNoRuleMatch;
+        } else {
+            err.cause = SimpleTreeTransform::TransformError::Cause::RequestedError_UnrecognizedNodeType;
+            err.unrecognizedNodeType = typeName;
+        }
+        errors.add(err);
+        return TransformType::Remove;
+    }
+    }
+    Q_UNREACHABLE();
+}
+
+// evaluate node templates in order; stops at the first failure
+template <typename Evaluator>
+void evaluateNodeTemplates(
+        const SimpleTreeTransform::NodeTransformRule& pattern,
+        const Tree::Node& node,
+        const Evaluator& eval,
+        int startNode,
+        int patternIndex,
+        QVector<Tree::Node>& newNodes,
+        ErrorSink& errors)
+{
+    bool isGood = true;
+    for (const auto& nodeTemplate : pattern.nodeTemplates) {
+        QString ty = eval.value(nodeTemplate.ty, isGood);
+        if (!isGood) {
+            SimpleTreeTransform::TransformError err;
+            err.srcNodeIndex = startNode;
+            err.patternIndex = patternIndex;
+            err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_NodeTemplate_NodeType;
+            errors.add(err);
+            break;
+        }
+        QStringList keyList;
+        QStringList valueList;
+        for (int i = 0, n = nodeTemplate.kvList.size(); i < n; ++i) {
+            const auto& kvPair = nodeTemplate.kvList.at(i);
+            bool isKeyGood = false;
+            bool isValueGood = false;
+            QString key = eval.value(kvPair.key, isKeyGood);
+            QString value = eval.value(kvPair.value, isValueGood);
+            if (isKeyGood && isValueGood) {
+                keyList.push_back(key);
+                valueList.push_back(value);
+            } else {
+                isGood = false;
+                SimpleTreeTransform::TransformError err;
+                err.srcNodeIndex = startNode;
+                err.patternIndex = patternIndex;
+                err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_NodeTemplate_KeyValue;
+                err.evalFailData.key = key;
+                err.evalFailData.value = value;
+                err.evalFailData.keyValueIndex = i;
+                err.evalFailData.isKeyGood = isKeyGood;
+                err.evalFailData.isValueGood = isValueGood;
+                errors.add(err);
+                break;
+            }
+        }
+        if (isGood) {
+            Q_ASSERT(nodeTemplate.parentIndex < newNodes.size());
+            Tree::Node newNode;
+            if (ty.isEmpty() && keyList.isEmpty() /* && valueList.isEmpty() */) {
+                setNodeData(newNode, node);
+            } else {
+                newNode.typeName = ty;
+                newNode.keyList = keyList;
+                newNode.valueList = valueList;
+            }
+            newNodes.push_back(newNode);
+        } else {
+            // we already have a failure; cannot promise the tree to be reconstructed fine
+            break;
+        }
+    }
+}
+
+// add evaluated template nodes in pre-order, children in template order
+// a template can be the child of any template before it, so the declaration order is not necessarily pre-order
+// addNode(parent, data) adds a node and returns its index, or -1 if the node (and its subtree) is dropped
+template <typename AddNodeFunc>
+void addTemplateNodes(
+        const QVector<SimpleTreeTransform::SubTreeNodeTemplate>& nodeTemplates,
+        QVector<Tree::Node>& newNodes,
+        int parent,
+        AddNodeFunc addNode)
+{
+    int numNewNodes = newNodes.size();
+    QVector<QVector<int>> templateChildren(numNewNodes);
+    QVector<int> templateRoots;
+    for (int i = 0; i < numNewNodes; ++i) {
+        int templateParent = nodeTemplates.at(i).parentIndex;
+        if (templateParent == -1) {
+            templateRoots.push_back(i);
+        } else {
+            templateChildren[templateParent].push_back(i);
+        }
+    }
+    QVector<QPair<int, int>> pending; // (template index, output parent)
+    for (int i = templateRoots.size() - 1; i >= 0; --i) {
+        pending.push_back(qMakePair(templateRoots.at(i), parent));
+    }
+    while (!pending.isEmpty()) {
+        QPair<int, int> cur = pending.takeLast();
+        int newNode = addNode(cur.second, newNodes[cur.first]);
+        if (newNode < 0) {
+            continue;
+        }
+        const QVector<int>& children = templateChildren.at(cur.first);
+        for (int i = children.size() - 1; i >= 0; --i) {
+            pending.push_back(qMakePair(children.at(i), newNode));
+        }
+    }
+}
+
+// apply patches of a Modify rule to dest
+template <typename Evaluator>
+void applyModifications(
+        const SimpleTreeTransform::NodeTransformRule& pattern,
+        Tree::Node& dest,
+        const Evaluator& eval,
+        int startNode,
+        int patternIndex,
+        ErrorSink& errors)
+{
+    for (int i = 0, n = pattern.modifications.size(); i < n; ++i) {
+        const auto& patch = pattern.modifications.at(i);
+        bool isKeyGood = false;
+        bool isValueGood = false;
+        QString key = eval.value(patch.key, isKeyGood);
+        QString value = eval.value(patch.value, isValueGood);
+        if (isKeyGood && isValueGood) {
+            if (key.isEmpty()) {
+                // we are modifying the type
+                dest.typeName = value;
+            } else {
+                int keyIndex = dest.keyList.indexOf(key);
+                if (keyIndex == -1) {
+                    dest.keyList.push_back(key);
+                    dest.valueList.push_back(value);
+                } else {
+                    // add a check that's basically only to ensure that keyIndex is in bound.
+                    if (dest.valueList.at(keyIndex) != value) {
+                        dest.valueList[keyIndex] = value;
                     }
                 }
-                if (!isAnyPredicateFailed) {
-                    // we get a pattern
-                    patternIndex = i;
-                    patternPtr = &pattern;
-                    break;
-                }
             }
+        } else {
+            // either key or value (or both) evaluation failed
+            // skip current patch
+            SimpleTreeTransform::TransformError err;
+            err.srcNodeIndex = startNode;
+            err.patternIndex = patternIndex;
+            err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_Modification;
+            err.evalFailData.key = key;
+            err.evalFailData.value = value;
+            err.evalFailData.keyValueIndex = i;
+            err.evalFailData.isKeyGood = isKeyGood;
+            err.evalFailData.isValueGood = isValueGood;
+            errors.add(err);
+            break;
         }
     }
+}
+
+// the output can only have one root; the extra root-level nodes of a replace on the root are dropped
+void addExtraRootError(ErrorSink& errors, int srcNodeIndex, int patternIndex)
+{
+    SimpleTreeTransform::TransformError err;
+    err.srcNodeIndex = srcNodeIndex;
+    err.patternIndex = patternIndex;
+    err.cause = SimpleTreeTransform::TransformError::Cause::ExtraRootNodeDropped;
+    errors.add(err);
+}
 
+// add an output node; -1 if it is dropped because a root already exists
+int addOutputNode(TransformPass& pass, int parent, const SimpleTreeTransform::NodeProvenance& src)
+{
+    if (parent == -1 && !pass.builder.isEmpty()) {
+        return -1;
+    }
+    int newNode = pass.builder.addNode(parent);
+    if (pass.isProvenanceRecorded) {
+        Q_ASSERT(newNode == pass.provenanceVec.size());
+        pass.provenanceVec.push_back(src);
+    }
+    return newNode;
+}
+
+// transform a single node; returns the output node to put the transformed children under, or -1 if children are not visited
+int transformNode(TransformPass& pass, int startNode, int parent)
+{
+    Q_ASSERT(pass.ctx.sideTreeList.size() == pass.transform.sideTreeNameList.size());
+    Tree::EvaluationContext& ctx = pass.ctx;
+    PreOrderTreeBuilder& builder = pass.builder;
+    QVector<int>& skipSrcVec = pass.skipSrcVec;
+    const Tree& tree = ctx.mainTree;
+    const Tree::Node& node = tree.getNode(startNode);
+    // the context is shared by the whole pass; it is not used after this node is done
+    ctx.startNodeIndex = startNode;
+    ContextEvaluator eval{ctx};
+
+    bool isRemovedBecauseSkipped = (!skipSrcVec.isEmpty() && skipSrcVec.at(startNode) >= 0);
+    int ruleListIndex = pass.nodeRuleListIndex.at(startNode);
+    int patternIndex = -1;
+    const SimpleTreeTransform::NodeTransformRule* patternPtr = nullptr;
+    SimpleTreeTransform::TransformProfile::RuleEntry* ruleCounters = nullptr;
+    if (pass.profileCounters && ruleListIndex >= 0) {
+        ruleCounters = pass.profileCounters->rules.data() + pass.ruleIdBase->at(ruleListIndex);
+    }
+    if (!isRemovedBecauseSkipped && ruleListIndex >= 0) {
+        patternPtr = selectPattern(pass.ruleLists.at(ruleListIndex), eval, patternIndex,
+                                   pass.predicateOrder? &pass.predicateOrder->at(ruleListIndex) : nullptr,
+                                   pass.predicateIdBase? &pass.predicateIdBase->at(ruleListIndex) : nullptr,
+                                   pass.predicateCounters, ruleCounters);
+    }
+    if (pass.profileCounters && !patternPtr) {
+        if (isRemovedBecauseSkipped) {
+            pass.profileCounters->numSkipped += 1;
+        } else if (ruleListIndex >= 0) {
+            pass.profileCounters->numDefaultAction += 1;
+        } else {
+            pass.profileCounters->numUnrecognizedAction += 1;
+        }
+    }
     if (patternPtr) {
         // mark all nodes destined at skipNodes for skipping
         // this have to be before applying decision so that skipping child node is visible in recursion
@@ -61,211 +545,1078 @@ void performTransformImpl(
         }
     }
 
-    decltype(patternPtr->ty) decision = SimpleTreeTransform::NodeTransformRule::TransformType::PassThrough;
-
+    TransformType decision = TransformType::PassThrough;
     if (isRemovedBecauseSkipped) {
-        decision = SimpleTreeTransform::NodeTransformRule::TransformType::Remove;
-    } else if (!isNodeTypeRecognized) {
-        // unrecognized node
-        decltype (transform.unrecognizedNodeActionOverride) act = SimpleTreeTransform::PredefinedAction::PassThrough;
-        if (transform.isUnrecognizedNodeUseDefaultAction) {
-            act = transform.defaultAction;
-        } else {
-            act = transform.unrecognizedNodeActionOverride;
-        }
-        switch (act) {
-        case SimpleTreeTransform::PredefinedAction::PassThrough:
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::PassThrough;
-            break;
-        case SimpleTreeTransform::PredefinedAction::Remove:
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::Remove;
-            break;
-        case SimpleTreeTransform::PredefinedAction::Error: {
-            SimpleTreeTransform::TransformError err;
-            err.srcNodeIndex = startNode;
-            err.patternIndex = patternIndex;
-            err.cause = SimpleTreeTransform::TransformError::Cause::RequestedError_UnrecognizedNodeType;
-            err.unrecognizedNodeType = node.typeName;
-            errors.push_back(err);
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::Remove;
-        }break;
-        }
-    } else if (patternIndex == -1) {
-        // default action
-        switch (transform.defaultAction) {
-        case SimpleTreeTransform::PredefinedAction::PassThrough:
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::PassThrough;
-            break;
-        case SimpleTreeTransform::PredefinedAction::Remove:
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::Remove;
-            break;
-        case SimpleTreeTransform::PredefinedAction::Error: {
-            SimpleTreeTransform::TransformError err;
-            err.srcNodeIndex = startNode;
-            err.patternIndex = patternIndex;
-            err.cause = SimpleTreeTransform::TransformError::Cause::RequestedError_DefaultActionForNoRuleMatch;
-            errors.push_back(err);
-            decision = SimpleTreeTransform::NodeTransformRule::TransformType::Remove;
-        }break;
-        }
-    } else {
-        Q_ASSERT(patternPtr);
+        decision = TransformType::Remove;
+    } else if (patternPtr) {
         decision = patternPtr->ty;
+    } else {
+        decision = getPredefinedDecision(pass.transform, ruleListIndex >= 0, startNode, node.typeName, pass.errors);
     }
 
+    // time spent on node templates or modifications of the selected rule
+    QElapsedTimer templateTimer;
+    if (ruleCounters && patternPtr) {
+        templateTimer.start();
+    }
     switch (decision) {
-    case SimpleTreeTransform::NodeTransformRule::TransformType::PassThrough: {
-        TreeBuilder::Node* newNode = builder.addNode(parent);
-        Q_ASSERT(newNode->getSequenceNumber() == provenanceVec.size());
-        newNode->setDataFromNode(node);
+    case TransformType::PassThrough: {
         SimpleTreeTransform::NodeProvenance src;
         src.srcNodeIndex = startNode;
         src.patternIndex = -1;
-        provenanceVec.push_back(src);
-        for (int childOffset : node.offsetToChildren) {
-            performTransformImpl(transform, tree, builder, sideTreeList, skipSrcVec, provenanceVec, errors, startNode + childOffset, newNode);
+        int newNode = addOutputNode(pass, parent, src);
+        if (newNode >= 0) {
+            setNodeData(builder.getNode(newNode), node);
         }
-    }break;
-    case SimpleTreeTransform::NodeTransformRule::TransformType::Remove: {
+        return newNode;
+    }
+    case TransformType::Remove: {
         // do nothing
     }break;
-    case SimpleTreeTransform::NodeTransformRule::TransformType::Replace: {
-        QList<TreeBuilder::Node*> newNodes;
+    case TransformType::Replace: {
+        QVector<Tree::Node> newNodes;
+        evaluateNodeTemplates(*patternPtr, node, eval, startNode, patternIndex, newNodes, pass.errors);
         SimpleTreeTransform::NodeProvenance src;
         src.srcNodeIndex = startNode;
         src.patternIndex = patternIndex;
-        bool isGood = true;
-        for (const auto& nodeTemplate : patternPtr->nodeTemplates) {
-            QString ty = Tree::evaluateGeneralValueExpression(nodeTemplate.ty, isGood, ctx);
-            if (!isGood) {
-                SimpleTreeTransform::TransformError err;
-                err.srcNodeIndex = startNode;
-                err.patternIndex = patternIndex;
-                err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_NodeTemplate_NodeType;
-                errors.push_back(err);
-                break;
-            }
-            QStringList keyList;
-            QStringList valueList;
-            for (int i = 0, n = nodeTemplate.kvList.size(); i < n; ++i) {
-                const auto& kvPair = nodeTemplate.kvList.at(i);
-                bool isKeyGood = false;
-                bool isValueGood = false;
-                QString key = Tree::evaluateGeneralValueExpression(kvPair.key, isKeyGood, ctx);
-                QString value = Tree::evaluateGeneralValueExpression(kvPair.value, isValueGood, ctx);
-                if (isKeyGood && isValueGood) {
-                    keyList.push_back(key);
-                    valueList.push_back(value);
-                } else {
-                    isGood = false;
-                    SimpleTreeTransform::TransformError err;
-                    err.srcNodeIndex = startNode;
-                    err.patternIndex = patternIndex;
-                    err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_NodeTemplate_KeyValue;
-                    err.evalFailData.key = key;
-                    err.evalFailData.value = value;
-                    err.evalFailData.keyValueIndex = i;
-                    err.evalFailData.isKeyGood = isKeyGood;
-                    err.evalFailData.isValueGood = isValueGood;
-                    errors.push_back(err);
-                    break;
-                }
-            }
-            if (isGood) {
-                TreeBuilder::Node* parentForNewNode = (nodeTemplate.parentIndex == -1)? parent : newNodes.at(nodeTemplate.parentIndex);
-                TreeBuilder::Node* newNode = builder.addNode(parentForNewNode);
-                Q_ASSERT(newNode->getSequenceNumber() == provenanceVec.size());
-                provenanceVec.push_back(src);
-                newNodes.push_back(newNode);
-                if (ty.isEmpty() && keyList.isEmpty() /* && valueList.isEmpty() */) {
-                    newNode->setDataFromNode(node);
-                } else {
-                    newNode->typeName = ty;
-                    newNode->keyList = keyList;
-                    newNode->valueList = valueList;
-                }
-            } else {
-                // we already have a failure; cannot promise the tree to be reconstructed fine
-                break;
+        addTemplateNodes(patternPtr->nodeTemplates, newNodes, parent, [&](int newParent, Tree::Node& data) -> int {
+            int newNode = addOutputNode(pass, newParent, src);
+            if (newNode >= 0) {
+                moveNodeData(builder.getNode(newNode), data);
+            } else if (newParent == -1) {
+                addExtraRootError(pass.errors, startNode, patternIndex);
             }
+            return newNode;
+        });
+        if (templateTimer.isValid()) {
+            ruleCounters[patternIndex].templateTimeNs += templateTimer.nsecsElapsed();
         }
         // we do not recurse into children for replace type
     }break;
-    case SimpleTreeTransform::NodeTransformRule::TransformType::Modify: {
-        TreeBuilder::Node* newNode = builder.addNode(parent);
-        Q_ASSERT(newNode->getSequenceNumber() == provenanceVec.size());
-        newNode->setDataFromNode(node);
+    case TransformType::Modify: {
         SimpleTreeTransform::NodeProvenance src;
         src.srcNodeIndex = startNode;
         src.patternIndex = -1;
-        provenanceVec.push_back(src);
+        int newNode = addOutputNode(pass, parent, src);
+        if (newNode < 0) {
+            return -1;
+        }
+        Tree::Node& dest = builder.getNode(newNode);
+        setNodeData(dest, node);
+        applyModifications(*patternPtr, dest, eval, startNode, patternIndex, pass.errors);
+        if (templateTimer.isValid()) {
+            ruleCounters[patternIndex].templateTimeNs += templateTimer.nsecsElapsed();
+        }
+        return newNode;
+    }
+    }
+    return -1;
+}
 
-        // apply patches to this node
-        for (int i = 0, n = patternPtr->modifications.size(); i < n; ++i) {
-            const auto& patch = patternPtr->modifications.at(i);
-            bool isKeyGood = false;
-            bool isValueGood = false;
-            QString key = Tree::evaluateGeneralValueExpression(patch.key, isKeyGood, ctx);
-            QString value = Tree::evaluateGeneralValueExpression(patch.value, isValueGood, ctx);
-            if (isKeyGood && isValueGood) {
-                if (key.isEmpty()) {
-                    // we are modifying the type
-                    newNode->typeName = value;
-                } else {
-                    int keyIndex = newNode->keyList.indexOf(key);
-                    if (keyIndex == -1) {
-                        newNode->keyList.push_back(key);
-                        newNode->valueList.push_back(value);
-                    } else {
-                        // add a check that's basically only to ensure that keyIndex is in bound.
-                        if (newNode->valueList.at(keyIndex) != value) {
-                            newNode->valueList[keyIndex] = value;
-                        }
-                    }
+void performTransformImpl(TransformPass& pass, int startNode, int depth, int parent)
+{
+    // walk over an explicit stack so that deep trees do not overflow the call stack
+    // children are pushed in reverse order so that nodes are still visited in pre-order
+    struct PendingNode {
+        int srcNodeIndex;
+        int depth;
+        int parent;
+    };
+    QVector<PendingNode> stack;
+    stack.push_back(PendingNode{startNode, depth, parent});
+    while (!stack.isEmpty()) {
+        PendingNode cur = stack.takeLast();
+        int newNode = transformNode(pass, cur.srcNodeIndex, cur.parent);
+        if (newNode < 0) {
+            continue;
+        }
+        const Tree::Node& node = pass.ctx.mainTree.getNode(cur.srcNodeIndex);
+        if (cur.depth + 1 == pass.partitionDepth) {
+            for (int childOffset : node.offsetToChildren) {
+                DeferredSubtree subtree;
+                subtree.srcNodeIndex = cur.srcNodeIndex + childOffset;
+                subtree.depth = cur.depth + 1;
+                subtree.parent = newNode;
+                pass.deferred.push_back(subtree);
+            }
+        } else {
+            for (int i = node.offsetToChildren.size() - 1; i >= 0; --i) {
+                stack.push_back(PendingNode{cur.srcNodeIndex + node.offsetToChildren.at(i), cur.depth + 1, newNode});
+            }
+        }
+    }
+}
+
+void transformDeferredSubtrees(TransformPass& pass, int numWorkers)
+{
+    struct SubtreeResult {
+        PreOrderTreeBuilder builder; // the root is a placeholder for the parent in the main builder
+        QVector<SimpleTreeTransform::NodeProvenance> provenanceVec;
+        ErrorSink errors;
+    };
+    int numSubtrees = pass.deferred.size();
+    std::vector<SubtreeResult> results(static_cast<std::size_t>(numSubtrees));
+    using PredicateCounters = QVector<SimpleTreeTransform::PredicateStatistics::Entry>;
+    auto transformSubtree = [&](int index, PredicateCounters* predicateCounters, ProfileCounters* profileCounters) -> void {
+        const DeferredSubtree& subtree = pass.deferred.at(index);
+        SubtreeResult& result = results[static_cast<std::size_t>(index)];
+        TransformPass subtreePass(pass.transform, pass.ruleLists, pass.nodeRuleListIndex,
+                                  pass.ctx.mainTree, pass.ctx.sideTreeList, result.builder, pass.skipSrcVec);
+        subtreePass.ctx.sideTreeIndices = pass.ctx.sideTreeIndices;
+        subtreePass.predicateOrder = pass.predicateOrder;
+        subtreePass.predicateIdBase = pass.predicateIdBase;
+        subtreePass.predicateCounters = predicateCounters;
+        subtreePass.profileCounters = profileCounters;
+        subtreePass.ruleIdBase = pass.ruleIdBase;
+        subtreePass.isProvenanceRecorded = pass.isProvenanceRecorded;
+        subtreePass.errors.recording = pass.errors.recording;
+        subtreePass.errors.isRecorded = pass.errors.isRecorded;
+        int placeholder = result.builder.addNode(-1);
+        if (subtreePass.isProvenanceRecorded) {
+            subtreePass.provenanceVec.push_back(SimpleTreeTransform::NodeProvenance());
+        }
+        performTransformImpl(subtreePass, subtree.srcNodeIndex, subtree.depth, placeholder);
+        result.provenanceVec.swap(subtreePass.provenanceVec);
+        result.errors = subtreePass.errors;
+    };
+
+    int numThreads = 1;
+#ifdef PP_ENABLE_THREADS
+    numThreads = (numWorkers > 0)? numWorkers : QThread::idealThreadCount();
+    numThreads = qBound(1, numThreads, numSubtrees);
+#else
+    Q_UNUSED(numWorkers)
+#endif
+    if (numThreads == 1) {
+        for (int i = 0; i < numSubtrees; ++i) {
+            transformSubtree(i, pass.predicateCounters, pass.profileCounters);
+        }
+    } else {
+#ifdef PP_ENABLE_THREADS
+        // skipSrcVec is not shared with any other QVector, so writes from different threads (to disjoint subtrees) never detach it
+        QAtomicInt nextIndex(0);
+        QMutex counterMutex;
+        auto work = [&]() -> void {
+            // each worker counts on its own and adds to the pass at the end
+            PredicateCounters workerCounters;
+            if (pass.predicateCounters) {
+                workerCounters.resize(pass.predicateCounters->size());
+            }
+            PredicateCounters* counters = pass.predicateCounters? &workerCounters : nullptr;
+            ProfileCounters workerProfile;
+            if (pass.profileCounters) {
+                workerProfile = makeProfileCounters(pass.ruleLists);
+            }
+            ProfileCounters* profile = pass.profileCounters? &workerProfile : nullptr;
+            for (int i = nextIndex.fetchAndAddOrdered(1); i < numSubtrees; i = nextIndex.fetchAndAddOrdered(1)) {
+                transformSubtree(i, counters, profile);
+            }
+            QMutexLocker locker(&counterMutex);
+            if (counters) {
+                for (int i = 0, n = workerCounters.size(); i < n; ++i) {
+                    (*pass.predicateCounters)[i] += workerCounters.at(i);
                 }
-            } else {
-                // either key or value (or both) evaluation failed
-                // skip current patch
-                SimpleTreeTransform::TransformError err;
-                err.srcNodeIndex = startNode;
-                err.patternIndex = patternIndex;
-                err.cause = SimpleTreeTransform::TransformError::Cause::EvaluationFail_Modification;
-                err.evalFailData.key = key;
-                err.evalFailData.value = value;
-                err.evalFailData.keyValueIndex = i;
-                err.evalFailData.isKeyGood = isKeyGood;
-                err.evalFailData.isValueGood = isValueGood;
-                errors.push_back(err);
-                break;
             }
+            if (profile) {
+                *pass.profileCounters += workerProfile;
+            }
+        };
+        QThreadPool pool;
+        pool.setMaxThreadCount(numThreads);
+        for (int i = 0; i < numThreads; ++i) {
+            pool.start(new FunctionRunnable(work));
+        }
+        pool.waitForDone();
+#endif
+    }
+
+    // rebuild the output in pre-order: the output of each subtree goes right after the node it is attached to,
+    // which has no other children
+    PreOrderTreeBuilder merged;
+    QVector<SimpleTreeTransform::NodeProvenance> mergedProvenance;
+    QVector<int> indexMap(pass.builder.getNumNodes(), -1);
+    int nextSubtree = 0;
+    for (int i = 0, n = pass.builder.getNumNodes(); i < n; ++i) {
+        Tree::Node& src = pass.builder.getNode(i);
+        int parent = (src.offsetFromParent == 0)? -1 : indexMap.at(i - src.offsetFromParent);
+        int newNode = merged.addNode(parent);
+        indexMap[i] = newNode;
+        Tree::Node& dest = merged.getNode(newNode);
+        dest.typeName.swap(src.typeName);
+        dest.keyList.swap(src.keyList);
+        dest.valueList.swap(src.valueList);
+        if (pass.isProvenanceRecorded) {
+            mergedProvenance.push_back(pass.provenanceVec.at(i));
+        }
+        for (; nextSubtree < numSubtrees && pass.deferred.at(nextSubtree).parent == i; ++nextSubtree) {
+            SubtreeResult& result = results[static_cast<std::size_t>(nextSubtree)];
+            merged.adoptChildren(result.builder, 0, newNode);
+            if (pass.isProvenanceRecorded) {
+                mergedProvenance.append(result.provenanceVec.mid(1));
+            }
+            pass.errors.append(result.errors);
+        }
+    }
+    Q_ASSERT(nextSubtree == numSubtrees);
+    pass.builder.swap(merged);
+    pass.provenanceVec.swap(mergedProvenance);
+    pass.deferred.clear();
+
+    // the sequential walk reports at most one error per source node, in pre-order
+    QVector<SimpleTreeTransform::TransformError>& errors = pass.errors.errors;
+    std::stable_sort(errors.begin(), errors.end(),
+                     [](const SimpleTreeTransform::TransformError& lhs, const SimpleTreeTransform::TransformError& rhs) -> bool {
+        return lhs.srcNodeIndex < rhs.srcNodeIndex;
+    });
+    // each part kept its own first error
+    if (pass.errors.recording == ErrorSink::ErrorRecording::FirstOnly && errors.size() > 1) {
+        errors.resize(1);
+    }
+}
+
+// relative cost of evaluating expressions; a traversal step costs much more than reading the current node
+double estimateSingleValueCost(const Tree::SingleValueExpression& expr)
+{
+    double cost = 1.0;
+    for (const auto& step : expr.traversal) {
+        cost += 10.0 + 2.0 * step.keyValueFilter.size();
+    }
+    return cost;
+}
+
+double estimatePredicateCost(const Tree::Predicate& pred)
+{
+    switch (pred.ty) {
+    case Tree::Predicate::PredicateType::ValueEqual:
+        return estimateSingleValueCost(pred.v1) + estimateSingleValueCost(pred.v2);
+    case Tree::Predicate::PredicateType::NodeExist: {
+        double cost = 1.0;
+        for (const auto& step : pred.nodeTest.steps) {
+            cost += 10.0 + 2.0 * step.keyValueFilter.size();
         }
+        return cost;
+    }
+    }
+    return 1.0;
+}
+
+bool isLocalSingleValue(const Tree::SingleValueExpression& expr)
+{
+    return expr.traversal.isEmpty()
+            && expr.treeIndex == -1
+            && expr.es != Tree::SingleValueExpression::EvaluateStrategy::TraverseOnly;
+}
 
-        for (int childOffset : node.offsetToChildren) {
-            performTransformImpl(transform, tree, builder, sideTreeList, skipSrcVec, provenanceVec, errors, startNode + childOffset, newNode);
+bool isLocalPredicate(const Tree::Predicate& pred)
+{
+    // node tests always traverse
+    return pred.ty == Tree::Predicate::PredicateType::ValueEqual
+            && isLocalSingleValue(pred.v1)
+            && isLocalSingleValue(pred.v2);
+}
+
+bool isLocalExpression(const Tree::GeneralValueExpression& expr)
+{
+    for (const auto& branch : expr.branches) {
+        if (!isLocalSingleValue(branch.value))
+            return false;
+        if (!std::all_of(branch.predicates.begin(), branch.predicates.end(), isLocalPredicate))
+            return false;
+    }
+    return true;
+}
+
+// traversal steps in side trees with a key value filter probe the child index on the first key of the filter
+using SideTreeIndexKeys = QVector<QPair<int, QString>>;
+
+void collectSideTreeIndexKeys(const QVector<Tree::NodeTraverseStep>& steps, int treeIndex, SideTreeIndexKeys& keys)
+{
+    if (treeIndex < 0)
+        return;
+    for (const auto& step : steps) {
+        if (step.destination == Tree::NodeTraverseStep::StepDestination::Parent || step.keyValueFilter.isEmpty())
+            continue;
+        QPair<int, QString> key = qMakePair(treeIndex, step.keyValueFilter.firstKey());
+        if (!keys.contains(key)) {
+            keys.push_back(key);
         }
+    }
+}
+
+void collectSideTreeIndexKeys(const Tree::Predicate& pred, SideTreeIndexKeys& keys)
+{
+    switch (pred.ty) {
+    case Tree::Predicate::PredicateType::ValueEqual:
+        collectSideTreeIndexKeys(pred.v1.traversal, pred.v1.treeIndex, keys);
+        collectSideTreeIndexKeys(pred.v2.traversal, pred.v2.treeIndex, keys);
+        break;
+    case Tree::Predicate::PredicateType::NodeExist:
+        collectSideTreeIndexKeys(pred.nodeTest.steps, pred.nodeTest.treeIndex, keys);
+        break;
+    }
+}
+
+void collectSideTreeIndexKeys(const Tree::GeneralValueExpression& expr, SideTreeIndexKeys& keys)
+{
+    for (const auto& branch : expr.branches) {
+        for (const auto& pred : branch.predicates) {
+            collectSideTreeIndexKeys(pred, keys);
+        }
+        collectSideTreeIndexKeys(branch.value.traversal, branch.value.treeIndex, keys);
+    }
+}
+
+void collectSideTreeIndexKeys(const SimpleTreeTransform::NodeTransformRule& rule, SideTreeIndexKeys& keys)
+{
+    for (const auto& pred : rule.predicates) {
+        collectSideTreeIndexKeys(pred, keys);
+    }
+    for (const auto& nodeTemplate : rule.nodeTemplates) {
+        collectSideTreeIndexKeys(nodeTemplate.ty, keys);
+        for (const auto& kvPair : nodeTemplate.kvList) {
+            collectSideTreeIndexKeys(kvPair.key, keys);
+            collectSideTreeIndexKeys(kvPair.value, keys);
+        }
+    }
+    for (const auto& patch : rule.modifications) {
+        collectSideTreeIndexKeys(patch.key, keys);
+        collectSideTreeIndexKeys(patch.value, keys);
+    }
+}
+
+using Footprint = SimpleTreeTransform::Footprint;
+
+Footprint getStepsFootprint(const QVector<Tree::NodeTraverseStep>& steps)
+{
+    Footprint result = Footprint::Node;
+    for (const auto& step : steps) {
+        if (step.destination != Tree::NodeTraverseStep::StepDestination::Child)
+            return Footprint::Tree;
+        result = Footprint::Subtree;
+    }
+    return result;
+}
+
+// side trees do not count; they are not supposed to change between incremental updates
+Footprint getSingleValueFootprint(const Tree::SingleValueExpression& expr)
+{
+    return (expr.treeIndex == -1)? getStepsFootprint(expr.traversal) : Footprint::Node;
+}
+
+Footprint getPredicateFootprint(const Tree::Predicate& pred)
+{
+    switch (pred.ty) {
+    case Tree::Predicate::PredicateType::ValueEqual:
+        return std::max(getSingleValueFootprint(pred.v1), getSingleValueFootprint(pred.v2));
+    case Tree::Predicate::PredicateType::NodeExist:
+        return (pred.nodeTest.treeIndex == -1)? getStepsFootprint(pred.nodeTest.steps) : Footprint::Node;
+    }
+    return Footprint::Tree;
+}
+
+Footprint getExpressionFootprint(const Tree::GeneralValueExpression& expr)
+{
+    Footprint result = Footprint::Node;
+    for (const auto& branch : expr.branches) {
+        result = std::max(result, getSingleValueFootprint(branch.value));
+        for (const auto& pred : branch.predicates) {
+            result = std::max(result, getPredicateFootprint(pred));
+        }
+    }
+    return result;
+}
+
+Footprint getRuleFootprint(const SimpleTreeTransform::NodeTransformRule& rule)
+{
+    Footprint result = Footprint::Node;
+    for (const auto& pred : rule.predicates) {
+        result = std::max(result, getPredicateFootprint(pred));
+    }
+    for (const auto& nodeTemplate : rule.nodeTemplates) {
+        result = std::max(result, getExpressionFootprint(nodeTemplate.ty));
+        for (const auto& kvPair : nodeTemplate.kvList) {
+            result = std::max(result, std::max(getExpressionFootprint(kvPair.key), getExpressionFootprint(kvPair.value)));
+        }
+    }
+    for (const auto& patch : rule.modifications) {
+        result = std::max(result, std::max(getExpressionFootprint(patch.key), getExpressionFootprint(patch.value)));
+    }
+    for (const auto& nodePath : rule.skipNodes) {
+        result = std::max(result, getStepsFootprint(nodePath));
+    }
+    return result;
+}
+
+// one past the last node in the subtree of index
+int getSubtreeEnd(const Tree& tree, int index)
+{
+    for (;;) {
+        const Tree::Node& node = tree.getNode(index);
+        if (node.offsetToChildren.isEmpty())
+            return index + 1;
+        index += node.offsetToChildren.last();
+    }
+}
+
+// one local transform in a fused walk; nodes are fed in pre-order of its input
+struct FusedStage {
+    const SimpleTreeTransform::Data* transform = nullptr;
+    const QHash<QString, int>* nodeTypeToRuleListIndex = nullptr;
+    const QVector<QVector<SimpleTreeTransform::NodeTransformRule>>* ruleLists = nullptr;
+    // for each input node, the output node to put its children under; -1 if its children are not visited
+    QVector<int> childParent;
+    ErrorSink errors;
+};
+
+// feed a node to stages[stageIndex] (or to builder after the last stage)
+// returns the index of the node in the input of the stage, or -1 if it is dropped because a root already exists
+int feedFusedNode(QVector<FusedStage>& stages, int stageIndex, PreOrderTreeBuilder& builder, int parent, Tree::Node& data)
+{
+    if (stageIndex == stages.size()) {
+        if (parent == -1 && !builder.isEmpty()) {
+            return -1;
+        }
+        int newNode = builder.addNode(parent);
+        moveNodeData(builder.getNode(newNode), data);
+        return newNode;
+    }
+
+    FusedStage& stage = stages[stageIndex];
+    if (parent == -1 && !stage.childParent.isEmpty()) {
+        return -1;
+    }
+    int inputIndex = stage.childParent.size();
+    int outputParent = -1;
+    if (parent >= 0) {
+        outputParent = stage.childParent.at(parent);
+        if (outputParent < 0) {
+            // the parent is removed or replaced
+            stage.childParent.push_back(-1);
+            return inputIndex;
+        }
+    }
+    // reserve the slot; stages after this one do not look at it
+    stage.childParent.push_back(-1);
+
+    auto emitNode = [&](int newParent, Tree::Node& newData) -> int {
+        return feedFusedNode(stages, stageIndex + 1, builder, newParent, newData);
+    };
+    LocalEvaluator eval{data};
+    int ruleListIndex = stage.nodeTypeToRuleListIndex->value(data.typeName, -1);
+    int patternIndex = -1;
+    const SimpleTreeTransform::NodeTransformRule* patternPtr = nullptr;
+    if (ruleListIndex >= 0) {
+        patternPtr = selectPattern(stage.ruleLists->at(ruleListIndex), eval, patternIndex);
+    }
+    TransformType decision = patternPtr? patternPtr->ty : getPredefinedDecision(*stage.transform, ruleListIndex >= 0, inputIndex, data.typeName, stage.errors);
+
+    int childOutputParent = -1;
+    switch (decision) {
+    case TransformType::PassThrough: {
+        // stages before this one do not need the data anymore
+        childOutputParent = emitNode(outputParent, data);
+    }break;
+    case TransformType::Remove: {
+        // do nothing
+    }break;
+    case TransformType::Replace: {
+        QVector<Tree::Node> newNodes;
+        evaluateNodeTemplates(*patternPtr, data, eval, inputIndex, patternIndex, newNodes, stage.errors);
+        addTemplateNodes(patternPtr->nodeTemplates, newNodes, outputParent, [&](int newParent, Tree::Node& newData) -> int {
+            int newNode = emitNode(newParent, newData);
+            if (newNode < 0 && newParent == -1) {
+                addExtraRootError(stage.errors, inputIndex, patternIndex);
+            }
+            return newNode;
+        });
+    }break;
+    case TransformType::Modify: {
+        Tree::Node newData;
+        setNodeData(newData, data);
+        applyModifications(*patternPtr, newData, eval, inputIndex, patternIndex, stage.errors);
+        childOutputParent = emitNode(outputParent, newData);
     }break;
     }
+    // emitNode may have appended to childParent of later stages only
+    stages[stageIndex].childParent[inputIndex] = childOutputParent;
+    return inputIndex;
 }
 
 } // end of anonymous namespace
 
-bool SimpleTreeTransform::performTransform(const Tree& tree, Tree& dest, const QList<const Tree*>& sideTreeList) const
+QString SimpleTreeTransform::TransformError::getCauseName(Cause cause)
+{
+    switch (cause) {
+    case Cause::RequestedError_UnrecognizedNodeType:        return QStringLiteral("UnrecognizedNodeType");
+    case Cause::RequestedError_DefaultActionForNoRuleMatch: return QStringLiteral("NoRuleMatch");
+    case Cause::EvaluationFail_NodeTemplate_NodeType:       return QStringLiteral("NodeTypeEvaluationFail");
+    case Cause::EvaluationFail_NodeTemplate_KeyValue:       return QStringLiteral("KeyValueEvaluationFail");
+    case Cause::EvaluationFail_Modification:                return QStringLiteral("ModificationFail");
+    case Cause::ExtraRootNodeDropped:                       return QStringLiteral("ExtraRootNodeDropped");
+    }
+    return QStringLiteral("<Unimplemented>");
+}
+
+void SimpleTreeTransform::compile()
+{
+    // rule lists are stored densely; node types are resolved to an index once per pass
+    nodeTypeToRuleListIndex.clear();
+    ruleLists.clear();
+    ruleLists.reserve(data.nodeTypeToRuleList.size());
+    ruleListNodeTypes.clear();
+    for (auto iter = data.nodeTypeToRuleList.begin(), iterEnd = data.nodeTypeToRuleList.end(); iter != iterEnd; ++iter) {
+        nodeTypeToRuleListIndex.insert(iter.key(), ruleLists.size());
+        ruleLists.push_back(iter.value());
+        ruleListNodeTypes.push_back(iter.key());
+    }
+
+    predicateIdBase.clear();
+    predicateStaticCost.clear();
+    ruleIdBase.clear();
+    numRules = 0;
+    for (const auto& ruleList : ruleLists) {
+        ruleIdBase.push_back(numRules);
+        numRules += ruleList.size();
+        QVector<int> bases;
+        for (const auto& rule : ruleList) {
+            bases.push_back(predicateStaticCost.size());
+            for (const auto& pred : rule.predicates) {
+                predicateStaticCost.push_back(estimatePredicateCost(pred));
+            }
+        }
+        predicateIdBase.push_back(bases);
+    }
+    updatePredicateOrder();
+
+    // subtrees can only be transformed independently if no rule skips nodes outside of the subtree of its node;
+    // predicates only read the source tree and are fine to go anywhere
+    isSkipSubtreeLocal = true;
+    isSkipUsed = false;
+    isLocal = data.sideTreeNameList.isEmpty();
+    ruleListFootprint.clear();
+    isTreeFootprintUsed = false;
+    sideTreeIndexKeys.clear();
+    for (const auto& ruleList : ruleLists) {
+        Footprint footprint = Footprint::Node;
+        for (const auto& rule : ruleList) {
+            footprint = std::max(footprint, getRuleFootprint(rule));
+        }
+        ruleListFootprint.push_back(footprint);
+        for (const auto& rule : ruleList) {
+            collectSideTreeIndexKeys(rule, sideTreeIndexKeys);
+        }
+        isTreeFootprintUsed = isTreeFootprintUsed || (footprint == Footprint::Tree);
+    }
+    for (const auto& ruleList : ruleLists) {
+        for (const auto& rule : ruleList) {
+            isSkipUsed = isSkipUsed || !rule.skipNodes.isEmpty();
+            for (const auto& nodePath : rule.skipNodes) {
+                for (const auto& step : nodePath) {
+                    if (step.destination != Tree::NodeTraverseStep::StepDestination::Child) {
+                        isSkipSubtreeLocal = false;
+                    }
+                }
+            }
+            if (!isLocal)
+                continue;
+            bool isRuleLocal = rule.skipNodes.isEmpty() && std::all_of(rule.predicates.begin(), rule.predicates.end(), isLocalPredicate);
+            for (const auto& nodeTemplate : rule.nodeTemplates) {
+                isRuleLocal = isRuleLocal && isLocalExpression(nodeTemplate.ty);
+                for (const auto& kvPair : nodeTemplate.kvList) {
+                    isRuleLocal = isRuleLocal && isLocalExpression(kvPair.key) && isLocalExpression(kvPair.value);
+                }
+            }
+            for (const auto& patch : rule.modifications) {
+                isRuleLocal = isRuleLocal && isLocalExpression(patch.key) && isLocalExpression(patch.value);
+            }
+            isLocal = isRuleLocal;
+        }
+    }
+}
+
+void SimpleTreeTransform::prepareSideTreeIndices(TreeChildIndexCache& cache, const QList<const Tree*>& sideTreeList) const
+{
+    for (const auto& key : sideTreeIndexKeys) {
+        if (key.first < sideTreeList.size()) {
+            cache.prepare(key.first, *sideTreeList.at(key.first), key.second);
+        }
+    }
+}
+
+void SimpleTreeTransform::setPredicateStatistics(const PredicateStatisticsPointer& stats)
+{
+    predicateStats = stats;
+    updatePredicateOrder();
+}
+
+void SimpleTreeTransform::updatePredicateOrder()
+{
+    // predicates that are cheap and likely to fail go first: order by cost / (1 - pass rate)
+    // without enough samples, use the static estimate and assume half of the evaluations pass
+    const qint64 minSamples = 32;
+    const double nsPerStaticCost = 50.0;
+    const double defaultPassRate = 0.5;
+    QMutexLocker locker(predicateStats? &predicateStats->mutex : nullptr);
+    predicateOrder.clear();
+    for (int listIndex = 0, numLists = ruleLists.size(); listIndex < numLists; ++listIndex) {
+        const auto& ruleList = ruleLists.at(listIndex);
+        const QVector<QVector<PredicateStatistics::Entry>>* listStats = nullptr;
+        if (predicateStats) {
+            auto iter = predicateStats->entries.constFind(ruleListNodeTypes.at(listIndex));
+            if (iter != predicateStats->entries.constEnd()) {
+                listStats = &iter.value();
+            }
+        }
+        QVector<QVector<int>> listOrder;
+        for (int ruleIndex = 0, numRules = ruleList.size(); ruleIndex < numRules; ++ruleIndex) {
+            int numPredicates = ruleList.at(ruleIndex).predicates.size();
+            QVector<int> order(numPredicates);
+            QVector<double> rank(numPredicates);
+            for (int i = 0; i < numPredicates; ++i) {
+                order[i] = i;
+                double cost = predicateStaticCost.at(predicateIdBase.at(listIndex).at(ruleIndex) + i) * nsPerStaticCost;
+                double passRate = defaultPassRate;
+                if (listStats && ruleIndex < listStats->size() && i < listStats->at(ruleIndex).size()) {
+                    const PredicateStatistics::Entry& entry = listStats->at(ruleIndex).at(i);
+                    if (entry.numEvaluated >= minSamples) {
+                        passRate = static_cast<double>(entry.numPassed) / static_cast<double>(entry.numEvaluated);
+                        if (entry.numTimed > 0) {
+                            cost = static_cast<double>(entry.totalTimeNs) / static_cast<double>(entry.numTimed);
+                        }
+                    }
+                }
+                rank[i] = cost / qMax(1.0 - passRate, 0.01);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) -> bool {
+                return rank.at(lhs) < rank.at(rhs);
+            });
+            listOrder.push_back(order);
+        }
+        predicateOrder.push_back(listOrder);
+    }
+}
+
+void SimpleTreeTransform::addPredicateStatistics(const QVector<PredicateStatistics::Entry>& counters) const
+{
+    Q_ASSERT(predicateStats);
+    QMutexLocker locker(&predicateStats->mutex);
+    for (int listIndex = 0, numLists = ruleLists.size(); listIndex < numLists; ++listIndex) {
+        const auto& ruleList = ruleLists.at(listIndex);
+        auto& listStats = predicateStats->entries[ruleListNodeTypes.at(listIndex)];
+        if (listStats.size() != ruleList.size()) {
+            // from a different version of the rules
+            listStats = QVector<QVector<PredicateStatistics::Entry>>(ruleList.size());
+        }
+        for (int ruleIndex = 0, numRules = ruleList.size(); ruleIndex < numRules; ++ruleIndex) {
+            int numPredicates = ruleList.at(ruleIndex).predicates.size();
+            auto& ruleStats = listStats[ruleIndex];
+            if (ruleStats.size() != numPredicates) {
+                ruleStats = QVector<PredicateStatistics::Entry>(numPredicates);
+            }
+            int base = predicateIdBase.at(listIndex).at(ruleIndex);
+            for (int i = 0; i < numPredicates; ++i) {
+                ruleStats[i] += counters.at(base + i);
+            }
+        }
+    }
+}
+
+void SimpleTreeTransform::addProfile(const QVector<TransformProfile::RuleEntry>& ruleCounters,
+                                     qint64 numDefaultAction, qint64 numUnrecognizedAction, qint64 numSkipped) const
+{
+    Q_ASSERT(profile);
+    Q_ASSERT(ruleCounters.size() == numRules);
+    QMutexLocker locker(&profile->mutex);
+    for (int listIndex = 0, numLists = ruleLists.size(); listIndex < numLists; ++listIndex) {
+        int numListRules = ruleLists.at(listIndex).size();
+        auto& listEntries = profile->rules[ruleListNodeTypes.at(listIndex)];
+        if (listEntries.size() != numListRules) {
+            // from a different version of the rules
+            listEntries = QVector<TransformProfile::RuleEntry>(numListRules);
+        }
+        for (int ruleIndex = 0; ruleIndex < numListRules; ++ruleIndex) {
+            listEntries[ruleIndex] += ruleCounters.at(ruleIdBase.at(listIndex) + ruleIndex);
+        }
+    }
+    profile->numDefaultAction += numDefaultAction;
+    profile->numUnrecognizedAction += numUnrecognizedAction;
+    profile->numSkipped += numSkipped;
+}
+
+bool SimpleTreeTransform::isParallelTransformApplicable() const
+{
+    return isSkipSubtreeLocal && parallelOptions.partitionDepth > 0;
+}
+
+QVector<int> SimpleTreeTransform::internNodeTypes(const Tree& tree) const
+{
+    // type names in a tree are mostly implicitly shared copies of a few strings,
+    // so each distinct string buffer only needs to be hashed once
+    int numNodes = tree.getNumNodes();
+    QVector<int> result(numNodes, -1);
+    QHash<const QChar*, int> bufferToRuleListIndex;
+    for (int i = 0; i < numNodes; ++i) {
+        const QString& ty = tree.getNode(i).typeName;
+        auto iter = bufferToRuleListIndex.find(ty.constData());
+        if (iter == bufferToRuleListIndex.end()) {
+            iter = bufferToRuleListIndex.insert(ty.constData(), nodeTypeToRuleListIndex.value(ty, -1));
+        }
+        result[i] = iter.value();
+    }
+    return result;
+}
+
+bool SimpleTreeTransform::performTransform(const Tree& tree, Tree& dest, const QList<const Tree*>& sideTreeList,
+                                           QVector<NodeProvenance>* provenance,
+                                           QVector<TransformError>* errors) const
 {
     int numNodes = tree.getNumNodes();
     if (Q_UNLIKELY(numNodes == 0)) {
         return true;
     }
     // for each node in source tree, which source node and pattern index cause it to be skipped
-    QVector<int> skipSrcVec(numNodes, -1);
-    QVector<NodeProvenance> srcVec;
-    QVector<TransformError> errors;
-    TreeBuilder builder;
-    srcVec.reserve(numNodes);
-    performTransformImpl(data, tree, builder, sideTreeList, skipSrcVec, srcVec, errors, 0, nullptr);
-    QVector<int> seqTable;
-    Tree newTree(builder, seqTable);
+    QVector<int> skipSrcVec;
+    if (isSkipUsed) {
+        skipSrcVec.fill(-1, numNodes);
+    }
+    PreOrderTreeBuilder builder;
+    builder.reserve(numNodes);
+    QVector<int> nodeRuleListIndex = internNodeTypes(tree);
+    TransformPass pass(data, ruleLists, nodeRuleListIndex, tree, sideTreeList, builder, skipSrcVec);
+    // lookups in side trees with key value filters become hash probes
+    TreeChildIndexCache sideTreeIndices;
+    prepareSideTreeIndices(sideTreeIndices, sideTreeList);
+    pass.ctx.sideTreeIndices = &sideTreeIndices;
+    pass.predicateOrder = &predicateOrder;
+    pass.predicateIdBase = &predicateIdBase;
+    QVector<PredicateStatistics::Entry> predicateCounters;
+    if (predicateStats) {
+        predicateCounters.resize(predicateStaticCost.size());
+        pass.predicateCounters = &predicateCounters;
+    }
+    ProfileCounters profileCounters;
+    if (profile) {
+        profileCounters = makeProfileCounters(ruleLists);
+        pass.profileCounters = &profileCounters;
+        pass.ruleIdBase = &ruleIdBase;
+    }
+    pass.isProvenanceRecorded = (provenance != nullptr);
+    if (pass.isProvenanceRecorded) {
+        pass.provenanceVec.reserve(numNodes);
+    }
+    pass.errors.recording = transformOptions.errorRecording;
+    pass.errors.isRecorded = (errors != nullptr);
+    if (isParallelTransformApplicable()) {
+        // nodes above the partition depth are transformed first so that their skips are visible to the subtrees
+        pass.partitionDepth = parallelOptions.partitionDepth;
+    }
+    performTransformImpl(pass, 0, 0, -1);
+    if (!pass.deferred.isEmpty()) {
+        transformDeferredSubtrees(pass, parallelOptions.numWorkers);
+    }
+    if (predicateStats) {
+        addPredicateStatistics(predicateCounters);
+    }
+    if (profile) {
+        addProfile(profileCounters.rules, profileCounters.numDefaultAction, profileCounters.numUnrecognizedAction, profileCounters.numSkipped);
+    }
+    // nodes are added in pre-order, so provenance is already in the order of nodes in dest
+    Tree newTree;
+    builder.takeTree(newTree);
+    if (provenance) {
+        provenance->swap(pass.provenanceVec);
+    }
+    if (errors) {
+        errors->swap(pass.errors.errors);
+    }
     dest.swap(newTree);
-    return (errors.isEmpty());
+    return (pass.errors.isEmpty());
+}
+
+// ----------------------------------------------------------------------------
+
+SimpleTreeTransformChain::SimpleTreeTransformChain(const QVector<SimpleTreeTransform::Data>& passData)
+{
+    for (const auto& d : passData) {
+        passes.push_back(SimpleTreeTransform(d));
+    }
+    // group consecutive local transforms
+    for (int i = 0, n = passes.size(); i < n;) {
+        int last = i + 1;
+        if (passes.at(i).isLocalTransform()) {
+            while (last < n && passes.at(last).isLocalTransform()) {
+                ++last;
+            }
+        }
+        walks.push_back(qMakePair(i, last));
+        i = last;
+    }
+}
+
+bool SimpleTreeTransformChain::performTransform(const Tree& tree, Tree& dest, const QVector<QList<const Tree*>>& sideTreeLists) const
+{
+    Q_ASSERT(sideTreeLists.size() == passes.size());
+    bool isAllGood = true;
+    Tree current = tree;
+    for (const auto& walk : walks) {
+        Tree result;
+        if (walk.second - walk.first > 1) {
+            isAllGood = performFusedTransform(walk.first, walk.second, current, result) && isAllGood;
+        } else {
+            isAllGood = passes.at(walk.first).performTransform(current, result, sideTreeLists.at(walk.first)) && isAllGood;
+        }
+        current.swap(result);
+    }
+    dest.swap(current);
+    return isAllGood;
+}
+
+bool SimpleTreeTransformChain::performFusedTransform(int firstPass, int lastPass, const Tree& tree, Tree& dest) const
+{
+    QVector<FusedStage> stages(lastPass - firstPass);
+    for (int i = firstPass; i < lastPass; ++i) {
+        const SimpleTreeTransform& pass = passes.at(i);
+        FusedStage& stage = stages[i - firstPass];
+        stage.transform = &pass.data;
+        stage.nodeTypeToRuleListIndex = &pass.nodeTypeToRuleListIndex;
+        stage.ruleLists = &pass.ruleLists;
+        // nobody reads errors of a chain
+        stage.errors.isRecorded = false;
+    }
+    PreOrderTreeBuilder builder;
+    // nodes of a tree are already in pre-order
+    for (int i = 0, n = tree.getNumNodes(); i < n; ++i) {
+        const Tree::Node& node = tree.getNode(i);
+        int parent = (i == 0)? -1 : i - node.offsetFromParent;
+        Tree::Node data;
+        setNodeData(data, node);
+        feedFusedNode(stages, 0, builder, parent, data);
+    }
+    Tree result;
+    builder.takeTree(result);
+    dest.swap(result);
+    for (const auto& stage : stages) {
+        if (!stage.errors.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+IncrementalTreeTransform::IncrementalTreeTransform(const SimpleTreeTransform& transformArg)
+    : transform(transformArg)
+{
+    SimpleTreeTransform::TransformOptions options = transform.getTransformOptions();
+    if (options.errorRecording == SimpleTreeTransform::TransformOptions::ErrorRecording::FirstOnly) {
+        options.errorRecording = SimpleTreeTransform::TransformOptions::ErrorRecording::All;
+        transform.setTransformOptions(options);
+    }
+}
+
+bool IncrementalTreeTransform::reset(const Tree& tree, const QList<const Tree*>& sideTreeListArg)
+{
+    sideTreeList = sideTreeListArg;
+    input = tree;
+    numTransformedNodes = tree.getNumNodes();
+    Tree newOutput;
+    provenance.clear();
+    errors.clear();
+    bool isGood = transform.performTransform(input, newOutput, sideTreeList, &provenance, &errors);
+    output.swap(newOutput);
+    return isGood;
+}
+
+bool IncrementalTreeTransform::update(const Tree& tree)
+{
+    int numOldNodes = input.getNumNodes();
+    int numNewNodes = tree.getNumNodes();
+    if (numOldNodes == 0 || numNewNodes == 0) {
+        return reset(tree, sideTreeList);
+    }
+    QVector<int> nodeRuleListIndex = transform.internNodeTypes(tree);
+    auto getFootprint = [&](int nodeIndex) -> Footprint {
+        int ruleListIndex = nodeRuleListIndex.at(nodeIndex);
+        return (ruleListIndex >= 0)? transform.ruleListFootprint.at(ruleListIndex) : Footprint::Node;
+    };
+    if (transform.isTreeFootprintUsed) {
+        for (int i = 0; i < numNewNodes; ++i) {
+            if (getFootprint(i) == Footprint::Tree) {
+                return reset(tree, sideTreeList);
+            }
+        }
+    }
+
+    // match nodes by position; a node with different data or number of children is dirty with all its descendants
+    QVector<int> oldToNew(numOldNodes, -1);
+    QVector<int> newToOld(numNewNodes, -1);
+    QVector<int> dirtyRoots;
+    QVector<QPair<int, int>> stack;
+    stack.push_back(qMakePair(0, 0));
+    while (!stack.isEmpty()) {
+        QPair<int, int> cur = stack.takeLast();
+        const Tree::Node& oldNode = input.getNode(cur.first);
+        const Tree::Node& newNode = tree.getNode(cur.second);
+        oldToNew[cur.first] = cur.second;
+        newToOld[cur.second] = cur.first;
+        if (oldNode.typeName != newNode.typeName
+                || oldNode.keyList != newNode.keyList
+                || oldNode.valueList != newNode.valueList
+                || oldNode.offsetToChildren.size() != newNode.offsetToChildren.size()) {
+            dirtyRoots.push_back(cur.second);
+            continue;
+        }
+        for (int i = oldNode.offsetToChildren.size() - 1; i >= 0; --i) {
+            stack.push_back(qMakePair(cur.first + oldNode.offsetToChildren.at(i), cur.second + newNode.offsetToChildren.at(i)));
+        }
+    }
+
+    // ancestors reading their subtree are transformed again together with the dirty nodes below them
+    QVector<int> regionRoots;
+    for (int dirtyRoot : dirtyRoots) {
+        int root = dirtyRoot;
+        for (int i = dirtyRoot; i > 0;) {
+            i -= tree.getNode(i).offsetFromParent;
+            if (getFootprint(i) == Footprint::Subtree) {
+                root = i;
+            }
+        }
+        if (root == 0) {
+            return reset(tree, sideTreeList);
+        }
+        regionRoots.push_back(root);
+    }
+    std::sort(regionRoots.begin(), regionRoots.end());
+
+    struct Region {
+        int oldRoot = -1;
+        int oldEnd = -1;
+        int newRoot = -1;
+        int newEnd = -1;
+        int outputBegin = -1; // [outputBegin, outputEnd) are the old output nodes from the region
+        int outputEnd = -1;
+        int outputParent = -1; // old output node the region is attached under; -1 if it is not visited
+        PreOrderTreeBuilder builder; // the root is a placeholder for outputParent
+        QVector<SimpleTreeTransform::NodeProvenance> provenanceVec;
+        QVector<SimpleTreeTransform::TransformError> errors;
+    };
+    std::vector<Region> regions;
+    // provenance is in pre-order of the source tree
+    auto findOutput = [&](int srcNodeIndex) -> int {
+        auto iter = std::lower_bound(provenance.begin(), provenance.end(), srcNodeIndex,
+                                     [](const SimpleTreeTransform::NodeProvenance& src, int value) -> bool {
+            return src.srcNodeIndex < value;
+        });
+        return static_cast<int>(iter - provenance.begin());
+    };
+    QVector<int> skipSrcVec;
+    if (transform.isSkipUsed) {
+        skipSrcVec.fill(-1, numNewNodes);
+    }
+    TreeChildIndexCache sideTreeIndices;
+    if (!regionRoots.isEmpty()) {
+        transform.prepareSideTreeIndices(sideTreeIndices, sideTreeList);
+    }
+    numTransformedNodes = 0;
+    for (int root : regionRoots) {
+        if (!regions.empty() && root < regions.back().newEnd) {
+            continue;
+        }
+        regions.push_back(Region());
+        Region& region = regions.back();
+        region.newRoot = root;
+        region.newEnd = getSubtreeEnd(tree, root);
+        region.oldRoot = newToOld.at(root);
+        region.oldEnd = getSubtreeEnd(input, region.oldRoot);
+        region.outputBegin = findOutput(region.oldRoot);
+        region.outputEnd = findOutput(region.oldEnd);
+
+        // the parent of the region is not transformed again; its children are visited only if it is kept
+        int oldParent = region.oldRoot - input.getNode(region.oldRoot).offsetFromParent;
+        for (int i = findOutput(oldParent), n = provenance.size(); i < n && provenance.at(i).srcNodeIndex == oldParent; ++i) {
+            if (provenance.at(i).patternIndex == -1) {
+                region.outputParent = i;
+                break;
+            }
+        }
+        if (region.outputParent < 0) {
+            Q_ASSERT(region.outputBegin == region.outputEnd);
+            continue;
+        }
+
+        TransformPass pass(transform.data, transform.ruleLists, nodeRuleListIndex, tree, sideTreeList, region.builder, skipSrcVec);
+        pass.ctx.sideTreeIndices = &sideTreeIndices;
+        pass.predicateOrder = &transform.predicateOrder;
+        pass.predicateIdBase = &transform.predicateIdBase;
+        pass.errors.recording = transform.getTransformOptions().errorRecording;
+        int placeholder = region.builder.addNode(-1);
+        pass.provenanceVec.push_back(SimpleTreeTransform::NodeProvenance());
+        performTransformImpl(pass, root, 0, placeholder);
+        region.provenanceVec.swap(pass.provenanceVec);
+        region.errors.swap(pass.errors.errors);
+        numTransformedNodes += region.newEnd - region.newRoot;
+    }
+
+    // copy the old output except the output of regions, which is replaced by the new one
+    PreOrderTreeBuilder builder;
+    builder.reserve(output.getNumNodes());
+    QVector<SimpleTreeTransform::NodeProvenance> newProvenance;
+    newProvenance.reserve(provenance.size());
+    QVector<int> outputIndexMap(output.getNumNodes(), -1);
+    int nextRegion = 0;
+    int numRegions = static_cast<int>(regions.size());
+    for (int i = 0, n = output.getNumNodes();;) {
+        if (nextRegion < numRegions && regions[static_cast<std::size_t>(nextRegion)].outputBegin == i) {
+            Region& region = regions[static_cast<std::size_t>(nextRegion)];
+            if (region.outputParent >= 0) {
+                builder.adoptChildren(region.builder, 0, outputIndexMap.at(region.outputParent));
+                newProvenance.append(region.provenanceVec.mid(1));
+            }
+            i = region.outputEnd;
+            ++nextRegion;
+            continue;
+        }
+        if (i >= n)
+            break;
+        const Tree::Node& src = output.getNode(i);
+        int parent = (src.offsetFromParent == 0)? -1 : outputIndexMap.at(i - src.offsetFromParent);
+        int newNode = builder.addNode(parent);
+        setNodeData(builder.getNode(newNode), src);
+        outputIndexMap[i] = newNode;
+        SimpleTreeTransform::NodeProvenance newSrc = provenance.at(i);
+        newSrc.srcNodeIndex = oldToNew.at(newSrc.srcNodeIndex);
+        newProvenance.push_back(newSrc);
+        ++i;
+    }
+
+    // errors outside of regions are kept
+    QVector<SimpleTreeTransform::TransformError> newErrors;
+    for (const auto& err : errors) {
+        auto iter = std::upper_bound(regions.begin(), regions.end(), err.srcNodeIndex,
+                                     [](int value, const Region& region) -> bool {
+            return value < region.oldRoot;
+        });
+        if (iter != regions.begin() && err.srcNodeIndex < (iter - 1)->oldEnd)
+            continue;
+        newErrors.push_back(err);
+        newErrors.last().srcNodeIndex = oldToNew.at(err.srcNodeIndex);
+    }
+    for (const auto& region : regions) {
+        newErrors.append(region.errors);
+    }
+    std::stable_sort(newErrors.begin(), newErrors.end(),
+                     [](const SimpleTreeTransform::TransformError& lhs, const SimpleTreeTransform::TransformError& rhs) -> bool {
+        return lhs.srcNodeIndex < rhs.srcNodeIndex;
+    });
+
+    input = tree;
+    Tree newOutput;
+    builder.takeTree(newOutput);
+    output.swap(newOutput);
+    provenance.swap(newProvenance);
+    errors.swap(newErrors);
+    return errors.isEmpty();
 }
 
 namespace {
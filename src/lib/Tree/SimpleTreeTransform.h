@@ -20,6 +20,8 @@
 
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
+#include <QMutex>
+#include <QSharedPointer>
 
 #include <functional>
 
@@ -89,7 +91,8 @@ public:
             RequestedError_DefaultActionForNoRuleMatch,
             EvaluationFail_NodeTemplate_NodeType,
             EvaluationFail_NodeTemplate_KeyValue,
-            EvaluationFail_Modification
+            EvaluationFail_Modification,
+            ExtraRootNodeDropped // a replace on the root produced more than one root-level node; only the first is kept
         };
         struct KeyValueEvaluationFailData {
             QString key;
@@ -106,16 +109,218 @@ public:
         QString unrecognizedNodeType;
         int modificationIndex = -1;
         // TODO enrich this
+
+        static QString getCauseName(Cause cause);
+    };
+
+    struct TransformOptions {
+        enum class ErrorRecording {
+            All,
+            FirstOnly, // only the first error in pre-order of the source tree; later ones are only counted
+            CodeOnly // srcNodeIndex, patternIndex and cause only; strings are left empty
+        };
+        ErrorRecording errorRecording = ErrorRecording::All;
+    };
+
+    // what rules of a node type may read from the main tree, besides the node itself
+    enum class Footprint {
+        Node,
+        Subtree, // traversals (and skips) only go to descendants
+        Tree
+    };
+
+    struct ParallelOptions {
+        // subtrees rooted at this depth are transformed concurrently; 0 to disable
+        // ignored (sequential transform) if any rule skips nodes outside of the subtree of its node
+        int partitionDepth = 0;
+        int numWorkers = 0; // 0 for one thread per core
+    };
+
+    // runtime statistics of rule predicates, kept across transforms with the same Data
+    // predicates of a rule are evaluated in the order of expected cost to reject a node
+    struct PredicateStatistics {
+        struct Entry {
+            qint64 numEvaluated = 0;
+            qint64 numPassed = 0;
+            qint64 numTimed = 0; // only a sample of evaluations is timed
+            qint64 totalTimeNs = 0;
+
+            Entry& operator+=(const Entry& rhs) {
+                numEvaluated += rhs.numEvaluated;
+                numPassed += rhs.numPassed;
+                numTimed += rhs.numTimed;
+                totalTimeNs += rhs.totalTimeNs;
+                return *this;
+            }
+        };
+        QMutex mutex; // transforms in different threads can share the statistics
+        // node type -> rule index -> predicate index
+        QHash<QString, QVector<QVector<Entry>>> entries;
     };
+    using PredicateStatisticsPointer = QSharedPointer<PredicateStatistics>;
+
+    // per-rule counters, added to by each transform while profiling is enabled
+    struct TransformProfile {
+        struct RuleEntry {
+            qint64 numEvaluated = 0; // nodes the rule is tried on
+            qint64 numMatched = 0;
+            QVector<qint64> numPredicateFailures; // by predicate index
+            qint64 predicateTimeNs = 0;
+            qint64 templateTimeNs = 0; // node templates of Replace or modifications of Modify
+
+            RuleEntry& operator+=(const RuleEntry& rhs) {
+                numEvaluated += rhs.numEvaluated;
+                numMatched += rhs.numMatched;
+                if (numPredicateFailures.size() < rhs.numPredicateFailures.size()) {
+                    numPredicateFailures.resize(rhs.numPredicateFailures.size());
+                }
+                for (int i = 0, n = rhs.numPredicateFailures.size(); i < n; ++i) {
+                    numPredicateFailures[i] += rhs.numPredicateFailures.at(i);
+                }
+                predicateTimeNs += rhs.predicateTimeNs;
+                templateTimeNs += rhs.templateTimeNs;
+                return *this;
+            }
+        };
+        QMutex mutex; // transforms in different threads can share the profile
+        QHash<QString, QVector<RuleEntry>> rules; // node type -> rule index
+        qint64 numDefaultAction = 0; // nodes whose type has rules but none of them matches
+        qint64 numUnrecognizedAction = 0; // nodes whose type has no rules
+        qint64 numSkipped = 0; // nodes removed by skipNodes of another node
+    };
+    using TransformProfilePointer = QSharedPointer<TransformProfile>;
 
 public:
     explicit SimpleTreeTransform(const Data& d)
         : data(d)
-    {}
-    bool performTransform(const Tree& tree, Tree& dest, const QList<const Tree*>& sideTreeList) const;
+    {
+        compile();
+    }
+    // provenance (if not null) receives the provenance of each node in dest; it is not collected otherwise
+    // errors (if not null) receives errors as configured in TransformOptions; they are only counted otherwise
+    bool performTransform(const Tree& tree, Tree& dest, const QList<const Tree*>& sideTreeList,
+                          QVector<NodeProvenance>* provenance = nullptr,
+                          QVector<TransformError>* errors = nullptr) const;
+
+    void setTransformOptions(const TransformOptions& options) {transformOptions = options;}
+    const TransformOptions& getTransformOptions() const {return transformOptions;}
+
+    void setParallelOptions(const ParallelOptions& options) {parallelOptions = options;}
+    const ParallelOptions& getParallelOptions() const {return parallelOptions;}
+    bool isParallelTransformApplicable() const;
+
+    // whether rules only read the node they are applied on (no side trees, traversals or skipped nodes)
+    // local transforms can be fused with others by SimpleTreeTransformChain
+    bool isLocalTransform() const {return isLocal;}
+
+    // predicate order is derived from the statistics here; the statistics are updated after each transform
+    // null to evaluate predicates in the estimated order without collecting statistics
+    void setPredicateStatistics(const PredicateStatisticsPointer& stats);
+    const PredicateStatisticsPointer& getPredicateStatistics() const {return predicateStats;}
+
+    // null to disable profiling; every rule of the transform has an entry after a transform
+    // transforms fused by SimpleTreeTransformChain are not profiled
+    void setProfile(const TransformProfilePointer& profileArg) {profile = profileArg;}
+    const TransformProfilePointer& getProfile() const {return profile;}
+
+private:
+    friend class SimpleTreeTransformChain;
+    friend class IncrementalTreeTransform;
+
+    void compile();
+
+    // map each node in tree to index in ruleLists; -1 if the node type has no rules
+    QVector<int> internNodeTypes(const Tree& tree) const;
+
+    void updatePredicateOrder();
+
+    // build the side tree indices the rules can probe, so that lookups during the walk do not lock
+    void prepareSideTreeIndices(TreeChildIndexCache& cache, const QList<const Tree*>& sideTreeList) const;
+    void addPredicateStatistics(const QVector<PredicateStatistics::Entry>& counters) const;
+    // ruleCounters is indexed by rule id
+    void addProfile(const QVector<TransformProfile::RuleEntry>& ruleCounters,
+                    qint64 numDefaultAction, qint64 numUnrecognizedAction, qint64 numSkipped) const;
+
 private:
     Data data;
-    // All data should be in Data; do not add stuff here
+    // All persistent data should be in Data; members below are derived in compile()
+    QHash<QString, int> nodeTypeToRuleListIndex;
+    QVector<QVector<NodeTransformRule>> ruleLists;
+    QStringList ruleListNodeTypes;
+    // [rule list][rule] -> id of the first predicate of the rule; ids are contiguous within a rule
+    QVector<QVector<int>> predicateIdBase;
+    QVector<double> predicateStaticCost; // by predicate id
+    QVector<int> ruleIdBase; // [rule list] -> id of the first rule in the list
+    int numRules = 0;
+    // [rule list][rule] -> order to evaluate predicates of the rule
+    QVector<QVector<QVector<int>>> predicateOrder;
+    bool isSkipSubtreeLocal = true;
+    bool isLocal = true;
+    bool isSkipUsed = false; // whether any rule has skipNodes
+    QVector<Footprint> ruleListFootprint;
+    bool isTreeFootprintUsed = false;
+    // (side tree index, key) of traversal steps in side trees that can use a child index
+    QVector<QPair<int, QString>> sideTreeIndexKeys;
+
+    TransformOptions transformOptions;
+    ParallelOptions parallelOptions;
+    PredicateStatisticsPointer predicateStats;
+    TransformProfilePointer profile;
+};
+
+// applies a sequence of transforms, each on the output of the previous one
+// consecutive local transforms are applied in a single pre-order walk without materializing intermediate trees;
+// other transforms are applied one by one
+class SimpleTreeTransformChain
+{
+public:
+    explicit SimpleTreeTransformChain(const QVector<SimpleTreeTransform::Data>& passData);
+
+    // sideTreeLists has the side trees for each pass
+    bool performTransform(const Tree& tree, Tree& dest, const QVector<QList<const Tree*>>& sideTreeLists) const;
+
+    int getNumPasses() const {return passes.size();}
+    // number of walks over a tree performTransform() makes
+    int getNumWalks() const {return walks.size();}
+
+private:
+    bool performFusedTransform(int firstPass, int lastPass, const Tree& tree, Tree& dest) const;
+
+private:
+    QList<SimpleTreeTransform> passes;
+    // [first, second) range of passes applied in each walk
+    QVector<QPair<int, int>> walks;
+};
+
+// keeps the input, output and provenance of the last transform so that when the input changes,
+// only the subtrees that may transform differently are transformed again and patched into the output
+// side trees must stay alive and unchanged between reset() and update()
+class IncrementalTreeTransform
+{
+public:
+    explicit IncrementalTreeTransform(const SimpleTreeTransform& transformArg);
+
+    // transform tree from scratch
+    bool reset(const Tree& tree, const QList<const Tree*>& sideTreeListArg);
+    // transform a changed version of the last input; same as reset() if the change can affect any node
+    bool update(const Tree& tree);
+
+    const Tree& getInput() const {return input;}
+    const Tree& getOutput() const {return output;}
+    const QVector<SimpleTreeTransform::NodeProvenance>& getProvenance() const {return provenance;}
+    // FirstOnly error recording is treated as All, since the first error can go away in an update
+    const QVector<SimpleTreeTransform::TransformError>& getErrors() const {return errors;}
+    // number of source nodes visited by the last reset() or update()
+    int getNumTransformedNodes() const {return numTransformedNodes;}
+
+private:
+    SimpleTreeTransform transform;
+    QList<const Tree*> sideTreeList;
+    Tree input;
+    Tree output;
+    QVector<SimpleTreeTransform::NodeProvenance> provenance;
+    QVector<SimpleTreeTransform::TransformError> errors;
+    int numTransformedNodes = 0;
 };
 
 #endif // SIMPLETREETRANSFORM_H
@@ -31,6 +31,11 @@ QString Tree::evaluateLocalValueExpression(const Tree::Node& startNode, const Lo
 }
 
 int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const NodeTraverseStep& step, bool &isGood) const
+{
+    return nodeTraverse(currentNodeIndex, localValueEvaluationNode, step, isGood, ChildIndexLookup());
+}
+
+int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const NodeTraverseStep& step, bool &isGood, const ChildIndexLookup& indexLookup) const
 {
     const auto& currentNode = nodes.at(currentNodeIndex);
 
@@ -41,29 +46,60 @@ int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNod
         return currentNodeIndex - currentNode.offsetFromParent;
     }
 
+    // preprocess key value type filter so that we don't have to consult start node all the time
+    QHash<QString, QString> keyValueFilter;
+    for (auto iter = step.keyValueFilter.begin(), iterEnd = step.keyValueFilter.end(); iter != iterEnd; ++iter) {
+        keyValueFilter.insert(iter.key(), evaluateLocalValueExpression(localValueEvaluationNode, iter.value(), isGood));
+        // here we don't care whether the expression evaluation is good; we just accept empty string upon failure
+    }
+
     std::vector<int> candidates;
-    switch (step.destination) {
-    case NodeTraverseStep::StepDestination::Parent: Q_UNREACHABLE();
-    case NodeTraverseStep::StepDestination::Peer: {
-        if (currentNode.offsetFromParent == 0) {
-            // root node has no other peer
-            candidates.push_back(currentNodeIndex);
-        } else {
-            // get all other peers
-            int parentIndex = currentNodeIndex - currentNode.offsetFromParent;
-            const auto& parent = nodes.at(parentIndex);
-            candidates.reserve(static_cast<std::size_t>(parent.offsetToChildren.size()));
-            for (int childOffset : parent.offsetToChildren) {
-                candidates.push_back(parentIndex + childOffset);
-            }
+
+    // with an index, only children with matching value on one of the keys are candidates
+    // the filters below still apply to them
+    const TreeChildIndex* index = nullptr;
+    int indexedParent = -1;
+    if (indexLookup.cache && !keyValueFilter.isEmpty()) {
+        if (step.destination == NodeTraverseStep::StepDestination::Child) {
+            indexedParent = currentNodeIndex;
+        } else if (currentNode.offsetFromParent > 0) {
+            indexedParent = currentNodeIndex - currentNode.offsetFromParent;
         }
-    }break;
-    case NodeTraverseStep::StepDestination::Child: {
-        candidates.reserve(static_cast<std::size_t>(currentNode.offsetToChildren.size()));
-        for (int childOffset : currentNode.offsetToChildren) {
-            candidates.push_back(currentNodeIndex + childOffset);
+        if (indexedParent >= 0) {
+            index = indexLookup.cache->get(indexLookup.treeIndex, *this, step.keyValueFilter.firstKey());
         }
     }
+
+    if (index) {
+        const QString& probeKey = step.keyValueFilter.firstKey();
+        const QVector<int>* children = index->find(indexedParent, step.childTypeFilter, keyValueFilter.value(probeKey));
+        if (children) {
+            candidates.assign(children->begin(), children->end());
+        }
+    } else {
+        switch (step.destination) {
+        case NodeTraverseStep::StepDestination::Parent: Q_UNREACHABLE();
+        case NodeTraverseStep::StepDestination::Peer: {
+            if (currentNode.offsetFromParent == 0) {
+                // root node has no other peer
+                candidates.push_back(currentNodeIndex);
+            } else {
+                // get all other peers
+                int parentIndex = currentNodeIndex - currentNode.offsetFromParent;
+                const auto& parent = nodes.at(parentIndex);
+                candidates.reserve(static_cast<std::size_t>(parent.offsetToChildren.size()));
+                for (int childOffset : parent.offsetToChildren) {
+                    candidates.push_back(parentIndex + childOffset);
+                }
+            }
+        }break;
+        case NodeTraverseStep::StepDestination::Child: {
+            candidates.reserve(static_cast<std::size_t>(currentNode.offsetToChildren.size()));
+            for (int childOffset : currentNode.offsetToChildren) {
+                candidates.push_back(currentNodeIndex + childOffset);
+            }
+        }
+        }
     }
 
     if (candidates.empty()) {
@@ -71,13 +107,6 @@ int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNod
         return currentNodeIndex;
     }
 
-    // preprocess key value type filter so that we don't have to consult start node all the time
-    QHash<QString, QString> keyValueFilter;
-    for (auto iter = step.keyValueFilter.begin(), iterEnd = step.keyValueFilter.end(); iter != iterEnd; ++iter) {
-        keyValueFilter.insert(iter.key(), evaluateLocalValueExpression(localValueEvaluationNode, iter.value(), isGood));
-        // here we don't care whether the expression evaluation is good; we just accept empty string upon failure
-    }
-
     // apply filters to candidates
     decltype(candidates) tmpList;
     tmpList.swap(candidates);
@@ -170,9 +199,14 @@ int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNod
 }
 
 int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const QVector<NodeTraverseStep>& steps, bool& isGood) const
+{
+    return nodeTraverse(currentNodeIndex, localValueEvaluationNode, steps, isGood, ChildIndexLookup());
+}
+
+int Tree::nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const QVector<NodeTraverseStep>& steps, bool& isGood, const ChildIndexLookup& indexLookup) const
 {
     for (const auto& step : steps) {
-        currentNodeIndex = nodeTraverse(currentNodeIndex, localValueEvaluationNode, step, isGood);
+        currentNodeIndex = nodeTraverse(currentNodeIndex, localValueEvaluationNode, step, isGood, indexLookup);
         if (!isGood)
             break;
     }
@@ -184,6 +218,12 @@ int Tree::nodeTraverse(const QVector<NodeTraverseStep>& steps, bool& isGood, con
     const Node& localvalueEvaluationNode = ctx.mainTree.getNode(ctx.startNodeIndex);
     const Tree& tree = (treeIndex == -1)? ctx.mainTree : *ctx.sideTreeList.at(treeIndex);
     int currentNodeIndex = (treeIndex == -1)? ctx.startNodeIndex : 0;
+    if (treeIndex >= 0 && ctx.sideTreeIndices) {
+        ChildIndexLookup indexLookup;
+        indexLookup.cache = ctx.sideTreeIndices;
+        indexLookup.treeIndex = treeIndex;
+        return tree.nodeTraverse(currentNodeIndex, localvalueEvaluationNode, steps, isGood, indexLookup);
+    }
     return tree.nodeTraverse(currentNodeIndex, localvalueEvaluationNode, steps, isGood);
 }
 
@@ -954,25 +994,42 @@ Tree::Tree(const TreeBuilder& tree, QVector<int>& sequenceNumberTable)
 void TreeBuilder::populateNodeList(QVector<Tree::Node>& nodes, QVector<int>& childTable, QVector<int> *sequenceNumberTable, int parentIndex, TreeBuilder::Node* subtreeRoot)
 {
     Q_ASSERT(subtreeRoot);
-    int nodeIndex = nodes.size();
-    {
+    auto appendNode = [&](TreeBuilder::Node* src, int parent) -> int {
+        int nodeIndex = nodes.size();
         Tree::Node curNode;
-        int offset = nodeIndex - parentIndex;
-        curNode.offsetFromParent = offset;
-        curNode.typeName = subtreeRoot->typeName;
-        curNode.keyList = subtreeRoot->keyList;
-        curNode.valueList = subtreeRoot->valueList;
+        curNode.offsetFromParent = nodeIndex - parent;
+        curNode.typeName = src->typeName;
+        curNode.keyList = src->keyList;
+        curNode.valueList = src->valueList;
         nodes.push_back(curNode);
         if (sequenceNumberTable) {
-            sequenceNumberTable->push_back(subtreeRoot->sequenceNumber);
+            sequenceNumberTable->push_back(src->sequenceNumber);
+        }
+        return nodeIndex;
+    };
+    int rootIndex = appendNode(subtreeRoot, parentIndex);
+    childTable.push_back(rootIndex - parentIndex);
+
+    // pre-order walk over an explicit stack so that deep trees do not overflow the call stack
+    // each entry is the next child to visit and the index of its parent
+    QVector<QPair<TreeBuilder::Node*, int>> stack;
+    if (subtreeRoot->childStart) {
+        stack.push_back(qMakePair(subtreeRoot->childStart, rootIndex));
+    }
+    while (!stack.isEmpty()) {
+        TreeBuilder::Node* child = stack.last().first;
+        int parent = stack.last().second;
+        if (child->nextPeer) {
+            stack.last().first = child->nextPeer;
+        } else {
+            stack.pop_back();
+        }
+        int nodeIndex = appendNode(child, parent);
+        nodes[parent].offsetToChildren.push_back(nodeIndex - parent);
+        if (child->childStart) {
+            stack.push_back(qMakePair(child->childStart, nodeIndex));
         }
-        childTable.push_back(offset);
-    }
-    QVector<int> childOffsets;
-    for (TreeBuilder::Node* child = subtreeRoot->childStart; child != nullptr; child = child->nextPeer) {
-        populateNodeList(nodes, childOffsets, sequenceNumberTable, nodeIndex, child);
     }
-    nodes[nodeIndex].offsetToChildren.swap(childOffsets);
 }
 
 void TreeBuilder::Node::detach()
@@ -1048,6 +1105,7 @@ void TreeBuilder::clear(){
         if (ptr)
             delete ptr;
     }
+    nodes.clear();
     sequenceCounter = 0;
     root = nullptr;
 }
@@ -1075,6 +1133,121 @@ TreeBuilder::Node* TreeBuilder::addNode(Node* parent)
 
 // ----------------------------------------------------------------------------
 
+uint qHash(const TreeChildIndex::IndexKey& key, uint seed)
+{
+    return qHash(key.parent, seed) ^ qHash(key.typeName, seed) ^ qHash(key.value, seed + 1);
+}
+
+TreeChildIndex::TreeChildIndex(const Tree& tree, const QString& key)
+{
+    for (int parent = 0, numNodes = tree.getNumNodes(); parent < numNodes; ++parent) {
+        for (int childOffset : tree.getNode(parent).offsetToChildren) {
+            int childIndex = parent + childOffset;
+            const Tree::Node& child = tree.getNode(childIndex);
+            IndexKey indexKey;
+            indexKey.parent = parent;
+            int keyIndex = child.keyList.indexOf(key);
+            if (keyIndex >= 0) {
+                indexKey.value = child.valueList.at(keyIndex);
+            }
+            children[indexKey].push_back(childIndex);
+            // a type filter is never empty
+            if (!child.typeName.isEmpty()) {
+                indexKey.typeName = child.typeName;
+                children[indexKey].push_back(childIndex);
+            }
+        }
+    }
+}
+
+const QVector<int>* TreeChildIndex::find(int parent, const QString& typeName, const QString& value) const
+{
+    IndexKey indexKey;
+    indexKey.parent = parent;
+    indexKey.typeName = typeName;
+    indexKey.value = value;
+    auto iter = children.find(indexKey);
+    if (iter == children.end()) {
+        return nullptr;
+    }
+    return &iter.value();
+}
+
+void TreeChildIndexCache::prepare(int treeIndex, const Tree& tree, const QString& key)
+{
+    QSharedPointer<TreeChildIndex>& ptr = preparedIndices[qMakePair(treeIndex, key)];
+    if (!ptr) {
+        ptr.reset(new TreeChildIndex(tree, key));
+    }
+}
+
+const TreeChildIndex* TreeChildIndexCache::get(int treeIndex, const Tree& tree, const QString& key)
+{
+    const auto& prepared = preparedIndices;
+    auto iter = prepared.constFind(qMakePair(treeIndex, key));
+    if (iter != prepared.constEnd()) {
+        return iter.value().data();
+    }
+    QMutexLocker locker(&mutex);
+    QSharedPointer<TreeChildIndex>& ptr = indices[qMakePair(treeIndex, key)];
+    if (!ptr) {
+        ptr.reset(new TreeChildIndex(tree, key));
+    }
+    return ptr.data();
+}
+
+// ----------------------------------------------------------------------------
+
+int PreOrderTreeBuilder::addNode(int parentIndex)
+{
+    int nodeIndex = nodes.size();
+    Tree::Node node;
+    if (parentIndex >= 0) {
+        Q_ASSERT(parentIndex < nodeIndex);
+        node.offsetFromParent = nodeIndex - parentIndex;
+        nodes[parentIndex].offsetToChildren.push_back(nodeIndex - parentIndex);
+    } else {
+        Q_ASSERT(nodes.isEmpty());
+    }
+    nodes.push_back(node);
+    return nodeIndex;
+}
+
+void PreOrderTreeBuilder::adoptChildren(PreOrderTreeBuilder& src, int srcParent, int newParent)
+{
+    Q_ASSERT(&src != this);
+    Q_ASSERT(newParent >= 0 && newParent < nodes.size());
+    int srcEnd = src.nodes.size();
+    int base = nodes.size();
+    nodes.reserve(base + (srcEnd - srcParent - 1));
+    for (int i = srcParent + 1; i < srcEnd; ++i) {
+        Tree::Node& srcNode = src.nodes[i];
+        int parentIndex = i - srcNode.offsetFromParent;
+        int nodeIndex = nodes.size();
+        if (parentIndex == srcParent) {
+            srcNode.offsetFromParent = nodeIndex - newParent;
+            nodes[newParent].offsetToChildren.push_back(nodeIndex - newParent);
+        }
+        // offsets among moved nodes do not change
+        nodes.push_back(Tree::Node());
+        nodes.last().typeName.swap(srcNode.typeName);
+        nodes.last().keyList.swap(srcNode.keyList);
+        nodes.last().valueList.swap(srcNode.valueList);
+        nodes.last().offsetFromParent = srcNode.offsetFromParent;
+        nodes.last().offsetToChildren.swap(srcNode.offsetToChildren);
+    }
+    src.nodes.resize(srcParent + 1);
+    src.nodes[srcParent].offsetToChildren.clear();
+}
+
+void PreOrderTreeBuilder::takeTree(Tree& dest)
+{
+    dest.nodes.swap(nodes);
+    nodes.clear();
+}
+
+// ----------------------------------------------------------------------------
+
 namespace {
 const QString XML_NODE = QStringLiteral("Node");
 const QString XML_TYPE = QStringLiteral("Type");
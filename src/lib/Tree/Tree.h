@@ -11,14 +11,22 @@
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 #include <QCoreApplication>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include <functional>
 
 #include "src/GlobalInclude.h"
 #include "src/utils/XMLUtilities.h"
 
 class TreeBuilder;
+class PreOrderTreeBuilder;
+class TreeChildIndex;
+class TreeChildIndexCache;
 class Tree
 {
     Q_DECLARE_TR_FUNCTIONS(Tree)
+    friend class PreOrderTreeBuilder;
 public:
     struct Node {
         QString typeName;
@@ -72,6 +80,8 @@ public:
         const Tree& mainTree;
         QList<const Tree*> sideTreeList;
         int startNodeIndex = 0;
+        // hash indices for traversals in side trees; null to always scan children
+        TreeChildIndexCache* sideTreeIndices = nullptr;
         explicit EvaluationContext(const Tree& mainTreeRef)
             : mainTree(mainTreeRef)
         {}
@@ -169,6 +179,16 @@ public:
 
     int nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const QVector<NodeTraverseStep>& steps, bool& isGood) const;
 
+    // where child indices of this tree come from; a null cache means children are always scanned
+    struct ChildIndexLookup {
+        TreeChildIndexCache* cache = nullptr;
+        int treeIndex = -1; // of this tree in the cache
+    };
+
+    // same as above, except that child and peer steps with key value filters probe indices from indexLookup instead of checking all children
+    int nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const NodeTraverseStep& step, bool& isGood, const ChildIndexLookup& indexLookup) const;
+    int nodeTraverse(int currentNodeIndex, const Node& localValueEvaluationNode, const QVector<NodeTraverseStep>& steps, bool& isGood, const ChildIndexLookup& indexLookup) const;
+
     static int nodeTraverse(const QVector<NodeTraverseStep> &steps, bool &isGood, const EvaluationContext& ctx, int treeIndex);
     static QString evaluateSingleValueExpression(const SingleValueExpression& expr, bool& isGood, const EvaluationContext& ctx);
     static bool evaluatePredicate(const Predicate& pred, bool& isGood, const EvaluationContext& ctx);
@@ -283,6 +303,7 @@ public:
     void setRoot(Node* newRoot){root = newRoot;}
     Node* allocateNode();
     Node* addNode(Node* parent);
+
 private:
     static void populateNodeList(QVector<Tree::Node>& nodes, QVector<int>& childTable, QVector<int>* sequenceNumberTable, int parentIndex, TreeBuilder::Node* subtreeRoot);
 private:
@@ -291,4 +312,89 @@ private:
     int sequenceCounter = 0;
 };
 
+/**
+ * @brief The TreeChildIndex class is a hash index over children of nodes in a tree on the value of one key
+ *
+ * Nodes without the key are indexed with an empty value, the same way key value filters in traversal treat them.
+ */
+class TreeChildIndex
+{
+public:
+    TreeChildIndex(const Tree& tree, const QString& key);
+
+    // children of parent (in order) whose value of the key is value, and whose type is typeName if it is not empty
+    // null if there is none
+    const QVector<int>* find(int parent, const QString& typeName, const QString& value) const;
+
+private:
+    struct IndexKey {
+        int parent;
+        QString typeName; // empty for children of any type
+        QString value;
+
+        bool operator==(const IndexKey& rhs) const {
+            return parent == rhs.parent && typeName == rhs.typeName && value == rhs.value;
+        }
+    };
+    friend uint qHash(const IndexKey& key, uint seed);
+
+    QHash<IndexKey, QVector<int>> children;
+};
+
+/**
+ * @brief The TreeChildIndexCache class holds child indices of side trees, built on first use
+ *
+ * It can be shared by evaluation contexts in different threads.
+ */
+class TreeChildIndexCache
+{
+public:
+    // build an index before it is used; must not be called while get() may run on another thread
+    // lookups of prepared indices do not lock
+    void prepare(int treeIndex, const Tree& tree, const QString& key);
+    const TreeChildIndex* get(int treeIndex, const Tree& tree, const QString& key);
+
+private:
+    QHash<QPair<int, QString>, QSharedPointer<TreeChildIndex>> preparedIndices; // read-only while in use
+    QMutex mutex; // guards indices
+    QHash<QPair<int, QString>, QSharedPointer<TreeChildIndex>> indices; // built on first use if not prepared
+};
+
+/**
+ * @brief The PreOrderTreeBuilder class builds a Tree by appending nodes in pre-order
+ *
+ * Unlike TreeBuilder, nodes are directly stored in the flat layout of Tree and child offsets are fixed up as nodes are added.
+ * The parent of a new node must be the node added last or one of its ancestors, so that every subtree stays contiguous.
+ */
+class PreOrderTreeBuilder
+{
+public:
+    /**
+     * @brief addNode append a node as the last child of parentIndex
+     * @param parentIndex index of parent node; -1 for the root
+     * @return index of the new node
+     */
+    int addNode(int parentIndex);
+
+    /**
+     * @brief adoptChildren move the subtrees under srcParent in src to be the last children of newParent
+     *
+     * The subtree of srcParent must be the last one in src; the moved nodes are removed from src.
+     */
+    void adoptChildren(PreOrderTreeBuilder& src, int srcParent, int newParent);
+
+    Tree::Node& getNode(int index) {return nodes[index];}
+    const Tree::Node& getNode(int index) const {return nodes.at(index);}
+    int getNumNodes() const {return nodes.size();}
+    bool isEmpty() const {return nodes.isEmpty();}
+    void reserve(int numNodes) {nodes.reserve(numNodes);}
+    void swap(PreOrderTreeBuilder& rhs) {nodes.swap(rhs.nodes);}
+
+    // move the result to dest; the builder is empty afterwards
+    void takeTree(Tree& dest);
+
+private:
+    QVector<Tree::Node> nodes;
+};
+
 #endif // TREE_H
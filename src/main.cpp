@@ -3,6 +3,7 @@
 #include "src/lib/StaticObjectIndexDB.h"
 #include "src/misc/Settings.h"
 #include "src/misc/MessageLogger.h"
+#include "src/misc/ParserBenchmark.h"
 #include "src/utils/NameSorting.h"
 
 #include <QApplication>
@@ -55,6 +56,52 @@ int main(int argc, char *argv[])
                                QCoreApplication::translate("main", "directory"));
     parser.addOption(startDirOpt);
 
+    QCommandLineOption benchmarkParserOpt("benchmark-parser",
+                                          QCoreApplication::translate("main", "Benchmark the given parser on input files (positional arguments) and exit"),
+                                          QCoreApplication::translate("main", "parser"));
+    parser.addOption(benchmarkParserOpt);
+
+    QCommandLineOption benchmarkIterationOpt("benchmark-iterations",
+                                             QCoreApplication::translate("main", "Number of iterations for each benchmark"),
+                                             QCoreApplication::translate("main", "count"),
+                                             QStringLiteral("10"));
+    parser.addOption(benchmarkIterationOpt);
+
+    QCommandLineOption benchmarkCompareEnginesOpt("benchmark-compare-engines",
+                                                  QCoreApplication::translate("main", "With --benchmark-parser, compare the pattern engines instead of measuring throughput"));
+    parser.addOption(benchmarkCompareEnginesOpt);
+
+    QCommandLineOption benchmarkSyntheticOpt("benchmark-synthetic",
+                                             QCoreApplication::translate("main", "Benchmark the parser on generated grammars and inputs and exit"));
+    parser.addOption(benchmarkSyntheticOpt);
+
+    QCommandLineOption benchmarkGrammarsOpt("benchmark-grammars",
+                                            QCoreApplication::translate("main", "Comma separated synthetic grammars (literal-<n>, regex-<n>, nesting-<depth>, classbased-<n>)"),
+                                            QCoreApplication::translate("main", "grammars"));
+    parser.addOption(benchmarkGrammarsOpt);
+
+    QCommandLineOption benchmarkSizesOpt("benchmark-sizes",
+                                         QCoreApplication::translate("main", "Comma separated synthetic input sizes (e.g. 1K,1M,1G)"),
+                                         QCoreApplication::translate("main", "sizes"));
+    parser.addOption(benchmarkSizesOpt);
+
+    QCommandLineOption stressDeepTreeOpt("stress-deep-tree",
+                                         QCoreApplication::translate("main", "Transform and generate text from a generated tree as deep as the first positional argument (default 1000000) and exit"));
+    parser.addOption(stressDeepTreeOpt);
+
+    QCommandLineOption benchmarkTransformMemoryOpt("benchmark-transform-memory",
+                                                   QCoreApplication::translate("main", "Measure peak memory of tree transform with the given configuration (lean: no provenance and code only errors; full: provenance and all errors) on a tree with as many nodes as the first positional argument (default 4000000) and exit; run each configuration in its own process to compare them"),
+                                                   QCoreApplication::translate("main", "config"));
+    parser.addOption(benchmarkTransformMemoryOpt);
+
+    QCommandLineOption checkTransformChainOpt("check-transform-chain",
+                                              QCoreApplication::translate("main", "Check fused transform chains against pass by pass transforms on as many generated cases as the first positional argument (default 1000) and exit"));
+    parser.addOption(checkTransformChainOpt);
+
+    QCommandLineOption checkIncrementalTransformOpt("check-incremental-transform",
+                                                    QCoreApplication::translate("main", "Check incremental tree transform updates against transforms from scratch on as many generated cases as the first positional argument (default 1000) and exit"));
+    parser.addOption(checkIncrementalTransformOpt);
+
     parser.addPositionalArgument(QCoreApplication::translate("main", "path"),
                                  QCoreApplication::translate("main", "The directory or file to open"));
 
@@ -85,6 +132,125 @@ int main(int argc, char *argv[])
     }
     NameSorting::init();
 
+    if (parser.isSet(benchmarkParserOpt)) {
+        ParserBenchmark::Options options;
+        options.parserPath = parser.value(benchmarkParserOpt);
+        options.inputPaths = parser.positionalArguments();
+        options.iterations = qMax(1, parser.value(benchmarkIterationOpt).toInt());
+        int retVal = parser.isSet(benchmarkCompareEnginesOpt)? ParserBenchmark::compareEngines(options) : ParserBenchmark::run(options);
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
+    if (parser.isSet(benchmarkSyntheticOpt)) {
+        ParserBenchmark::SyntheticOptions options;
+        options.iterations = qMax(1, parser.value(benchmarkIterationOpt).toInt());
+        int retVal = 0;
+        if (parser.isSet(benchmarkGrammarsOpt)) {
+            options.grammars = parser.value(benchmarkGrammarsOpt).split(',', QString::SkipEmptyParts);
+        }
+        if (parser.isSet(benchmarkSizesOpt)) {
+            for (const QString& sizeStr : parser.value(benchmarkSizesOpt).split(',', QString::SkipEmptyParts)) {
+                qint64 size = ParserBenchmark::parseSize(sizeStr);
+                if (size < 0) {
+                    qDebug() << "Invalid benchmark size" << sizeStr;
+                    retVal = 1;
+                } else {
+                    options.inputSizes.push_back(size);
+                }
+            }
+        }
+        if (retVal == 0) {
+            retVal = ParserBenchmark::runSynthetic(options);
+        }
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
+    if (parser.isSet(stressDeepTreeOpt)) {
+        int depth = 1000000;
+        int retVal = 0;
+        if (!parser.positionalArguments().isEmpty()) {
+            bool isGood = false;
+            depth = parser.positionalArguments().front().toInt(&isGood);
+            if (!isGood || depth <= 0) {
+                qDebug() << "Invalid tree depth" << parser.positionalArguments().front();
+                retVal = 1;
+            }
+        }
+        if (retVal == 0) {
+            retVal = ParserBenchmark::stressDeepTree(depth);
+        }
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
+    if (parser.isSet(benchmarkTransformMemoryOpt)) {
+        int numNodes = 4000000;
+        int retVal = 0;
+        if (!parser.positionalArguments().isEmpty()) {
+            bool isGood = false;
+            numNodes = parser.positionalArguments().front().toInt(&isGood);
+            if (!isGood || numNodes <= 0) {
+                qDebug() << "Invalid node count" << parser.positionalArguments().front();
+                retVal = 1;
+            }
+        }
+        if (retVal == 0) {
+            retVal = ParserBenchmark::runTransformMemory(parser.value(benchmarkTransformMemoryOpt), numNodes);
+        }
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
+    if (parser.isSet(checkTransformChainOpt)) {
+        int numCases = 1000;
+        int retVal = 0;
+        if (!parser.positionalArguments().isEmpty()) {
+            bool isGood = false;
+            numCases = parser.positionalArguments().front().toInt(&isGood);
+            if (!isGood || numCases <= 0) {
+                qDebug() << "Invalid case count" << parser.positionalArguments().front();
+                retVal = 1;
+            }
+        }
+        if (retVal == 0) {
+            retVal = ParserBenchmark::checkTransformChain(numCases);
+        }
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
+    if (parser.isSet(checkIncrementalTransformOpt)) {
+        int numCases = 1000;
+        int retVal = 0;
+        if (!parser.positionalArguments().isEmpty()) {
+            bool isGood = false;
+            numCases = parser.positionalArguments().front().toInt(&isGood);
+            if (!isGood || numCases <= 0) {
+                qDebug() << "Invalid case count" << parser.positionalArguments().front();
+                retVal = 1;
+            }
+        }
+        if (retVal == 0) {
+            retVal = ParserBenchmark::checkIncrementalTransform(numCases);
+        }
+        Settings::destructInstance();
+        StaticObjectIndexDB::destructInstance();
+        MessageLogger::destructInstance();
+        return retVal;
+    }
+
     QString startDirectory;
     if (parser.isSet(startDirOpt)) {
         startDirectory = parser.value(startDirOpt);
@@ -0,0 +1,1215 @@
+#include "src/misc/ParserBenchmark.h"
+#include "src/lib/FileBackedObject.h"
+#include "src/lib/TaskObject/SimpleParserObject.h"
+#include "src/lib/Tree/SimpleParser.h"
+#include "src/lib/Tree/SimpleTreeTransform.h"
+#include "src/lib/Tree/SimpleTextGenerator.h"
+#include "src/lib/Tree/EventLogging.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QTemporaryFile>
+
+#include <functional>
+#include <memory>
+#include <random>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct Measurement {
+    qint64 elapsedNs = 0;
+    bool isGood = true;
+};
+
+// without the fast paths, untraced parsing takes the same code path as traced parsing except for the logging
+Measurement measureParsing(const SimpleParser::Data& data, const QString& text, int iterations, bool isTraced, bool isFastPathEnabled)
+{
+    Measurement result;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        // parser and logger creation are not part of the measurement
+        SimpleParser parser(data);
+        parser.setUntracedFastPathEnabled(isFastPathEnabled);
+        std::unique_ptr<EventLogger> logger;
+        if (isTraced) {
+            logger.reset(new EventLogger);
+            logger->installInterpreter(SimpleParserEvent::getInterpreter());
+        }
+        Tree tree;
+        timer.start();
+        bool isGood = parser.performParsing(text, tree, logger.get());
+        result.elapsedNs += timer.nsecsElapsed();
+        if (!isGood) {
+            result.isGood = false;
+        }
+    }
+    return result;
+}
+
+double getThroughput(qint64 numChars, int iterations, qint64 elapsedNs)
+{
+    if (elapsedNs <= 0)
+        return 0;
+    // million characters per second
+    return static_cast<double>(numChars) * iterations * 1000.0 / static_cast<double>(elapsedNs);
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::run(const Options& options)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    std::unique_ptr<FileBackedObject> obj(FileBackedObject::open(options.parserPath, nullptr));
+    SimpleParserObject* parserObj = qobject_cast<SimpleParserObject*>(obj.get());
+    if (!parserObj) {
+        err << "Cannot load parser from " << options.parserPath << '\n';
+        return 1;
+    }
+    const SimpleParser::Data& data = parserObj->getData();
+
+    int retVal = 0;
+    // "logging" is the speedup from dropping the event log alone; "fast path" is the extra speedup of the untraced-only fast paths
+    out << "input\tchars\titerations\ttraced(Mchar/s)\tuntraced(Mchar/s)\tuntraced+fastpath(Mchar/s)\tlogging speedup\tfast path speedup" << '\n';
+    for (const QString& path : options.inputPaths) {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            err << "Cannot open input " << path << '\n';
+            retVal = 1;
+            continue;
+        }
+        QString text = QString::fromUtf8(f.readAll());
+        f.close();
+
+        Measurement traced = measureParsing(data, text, options.iterations, true, true);
+        Measurement untraced = measureParsing(data, text, options.iterations, false, false);
+        Measurement fastPath = measureParsing(data, text, options.iterations, false, true);
+        if (!traced.isGood || !untraced.isGood || !fastPath.isGood) {
+            err << "Parsing failed for " << path << '\n';
+            retVal = 1;
+        }
+
+        double tracedThroughput = getThroughput(text.length(), options.iterations, traced.elapsedNs);
+        double untracedThroughput = getThroughput(text.length(), options.iterations, untraced.elapsedNs);
+        double fastPathThroughput = getThroughput(text.length(), options.iterations, fastPath.elapsedNs);
+        out << QFileInfo(path).fileName() << '\t'
+            << text.length() << '\t'
+            << options.iterations << '\t'
+            << tracedThroughput << '\t'
+            << untracedThroughput << '\t'
+            << fastPathThroughput << '\t'
+            << (tracedThroughput > 0? untracedThroughput / tracedThroughput : 0) << '\t'
+            << (untracedThroughput > 0? fastPathThroughput / untracedThroughput : 0) << '\n';
+    }
+    return retVal;
+}
+
+// ----------------------------------------------------------------------------
+// synthetic benchmark
+
+namespace {
+
+// inputs larger than this are parsed from a temporary file with streaming parsing
+const qint64 MAX_IN_MEMORY_INPUT_SIZE = 256 * 1024 * 1024;
+
+const QString CONTENT_TYPE_NAME = QStringLiteral("Text");
+
+struct SyntheticGrammar {
+    QString name;
+    SimpleParser::Data data;
+    std::function<void(QString&, qint64)> appendLine; // append the line with given index to the text
+};
+
+SimpleParser::PatternElement makeElement(SimpleParser::PatternElement::ElementType ty, const QString& str, const QString& elementName = QString())
+{
+    SimpleParser::PatternElement pe;
+    pe.ty = ty;
+    pe.str = str;
+    pe.elementName = elementName;
+    return pe;
+}
+
+SimpleParser::PatternElement makeLiteral(const QString& str)
+{
+    return makeElement(SimpleParser::PatternElement::ElementType::AnonymousBoundary_StringLiteral, str);
+}
+
+SimpleParser::PatternElement makeContent(const QString& exportName)
+{
+    return makeElement(SimpleParser::PatternElement::ElementType::Content, CONTENT_TYPE_NAME, exportName);
+}
+
+SimpleParser::PatternElement makeLineFeed()
+{
+    return makeElement(SimpleParser::PatternElement::ElementType::AnonymousBoundary_SpecialCharacter_LineFeed, QString());
+}
+
+SimpleParser::Data makeBaseData()
+{
+    SimpleParser::Data data;
+    data.whitespaceList = QStringList({QStringLiteral(" "), QStringLiteral("\t")});
+    SimpleParser::ContentType content;
+    content.name = CONTENT_TYPE_NAME;
+    data.contentTypes.push_back(content);
+    return data;
+}
+
+SimpleParser::MatchRuleNode makeRuleNode(const QString& name, const QVector<SimpleParser::PatternElement>& elements)
+{
+    SimpleParser::MatchRuleNode node;
+    node.name = name;
+    SimpleParser::Pattern pattern;
+    pattern.typeName = name;
+    pattern.pattern = elements;
+    node.patterns.push_back(pattern);
+    return node;
+}
+
+// n top-level rules, each starting with a distinct keyword
+SyntheticGrammar makeLiteralGrammar(int n)
+{
+    SyntheticGrammar g;
+    g.data = makeBaseData();
+    for (int i = 0; i < n; ++i) {
+        QString name = QStringLiteral("Keyword%1").arg(i);
+        g.data.matchRuleNodes.push_back(makeRuleNode(name, {makeLiteral(QStringLiteral("kw%1:").arg(i)), makeContent(QStringLiteral("value")), makeLineFeed()}));
+        g.data.topNodeList.push_back(name);
+    }
+    g.appendLine = [n](QString& text, qint64 line) -> void {
+        text.append(QStringLiteral("kw%1: lorem ipsum dolor %2\n").arg(QString::number(line % n), QString::number(line)));
+    };
+    return g;
+}
+
+// n top-level rules, each starting with a distinct regex
+SyntheticGrammar makeRegexGrammar(int n)
+{
+    SyntheticGrammar g;
+    g.data = makeBaseData();
+    for (int i = 0; i < n; ++i) {
+        QString name = QStringLiteral("Regex%1").arg(i);
+        g.data.matchRuleNodes.push_back(makeRuleNode(name, {
+            makeElement(SimpleParser::PatternElement::ElementType::AnonymousBoundary_Regex, QStringLiteral("r%1_[0-9]+:").arg(i)),
+            makeContent(QStringLiteral("value")),
+            makeLineFeed()
+        }));
+        g.data.topNodeList.push_back(name);
+    }
+    g.appendLine = [n](QString& text, qint64 line) -> void {
+        text.append(QStringLiteral("r%1_%2: lorem ipsum dolor\n").arg(QString::number(line % n), QString::number(line)));
+    };
+    return g;
+}
+
+// a chain of rules where level i is the only child of level i-1; input walks down the chain repeatedly
+SyntheticGrammar makeNestingGrammar(int depth)
+{
+    SyntheticGrammar g;
+    g.data = makeBaseData();
+    for (int i = 0; i < depth; ++i) {
+        QString name = QStringLiteral("Level%1").arg(i);
+        auto node = makeRuleNode(name, {makeLiteral(QStringLiteral("L%1:").arg(i)), makeContent(QStringLiteral("value")), makeLineFeed()});
+        if (i + 1 < depth) {
+            node.childNodeNameList.push_back(QStringLiteral("Level%1").arg(i + 1));
+        }
+        g.data.matchRuleNodes.push_back(node);
+    }
+    g.data.topNodeList.push_back(QStringLiteral("Level0"));
+    g.appendLine = [depth](QString& text, qint64 line) -> void {
+        text.append(QStringLiteral("L%1: lorem ipsum %2\n").arg(QString::number(line % depth), QString::number(line)));
+    };
+    return g;
+}
+
+// key-value lines where the separator is any of n alternatives of one class-based boundary
+SyntheticGrammar makeClassBasedGrammar(int n)
+{
+    SyntheticGrammar g;
+    g.data = makeBaseData();
+    SimpleParser::NamedBoundary sep;
+    sep.ty = SimpleParser::BoundaryType::ClassBased;
+    sep.name = QStringLiteral("Separator");
+    for (int i = 0; i < n; ++i) {
+        SimpleParser::BoundaryDeclaration decl;
+        decl.decl = SimpleParser::BoundaryDeclaration::DeclarationType::Value;
+        decl.ty = SimpleParser::BoundaryType::StringLiteral;
+        decl.str = QStringLiteral("~%1~").arg(i);
+        sep.elements.push_back(decl);
+    }
+    g.data.namedBoundaries.push_back(sep);
+    g.data.matchRuleNodes.push_back(makeRuleNode(QStringLiteral("Pair"), {
+        makeLiteral(QStringLiteral("kv ")),
+        makeContent(QStringLiteral("key")),
+        makeElement(SimpleParser::PatternElement::ElementType::NamedBoundary, sep.name),
+        makeContent(QStringLiteral("value")),
+        makeLineFeed()
+    }));
+    g.data.topNodeList.push_back(QStringLiteral("Pair"));
+    g.appendLine = [n](QString& text, qint64 line) -> void {
+        text.append(QStringLiteral("kv key%1 ~%2~ value\n").arg(QString::number(line), QString::number(line % n)));
+    };
+    return g;
+}
+
+bool makeSyntheticGrammar(const QString& name, SyntheticGrammar& result)
+{
+    int dash = name.lastIndexOf('-');
+    if (dash <= 0)
+        return false;
+    QString family = name.left(dash);
+    bool isGood = false;
+    int param = name.mid(dash + 1).toInt(&isGood);
+    if (!isGood || param <= 0)
+        return false;
+    if (family == QLatin1String("literal")) {
+        result = makeLiteralGrammar(param);
+    } else if (family == QLatin1String("regex")) {
+        result = makeRegexGrammar(param);
+    } else if (family == QLatin1String("nesting")) {
+        result = makeNestingGrammar(param);
+    } else if (family == QLatin1String("classbased")) {
+        result = makeClassBasedGrammar(param);
+    } else {
+        return false;
+    }
+    result.name = name;
+    return true;
+}
+
+// peak resident set size of this process in KiB; -1 if unknown
+qint64 getPeakRSS()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+    }
+    return -1;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_MACOS)
+    return static_cast<qint64>(usage.ru_maxrss / 1024); // bytes on macOS
+#else
+    return static_cast<qint64>(usage.ru_maxrss);
+#endif
+#else
+    return -1;
+#endif
+}
+
+struct SyntheticMeasurement {
+    qint64 elapsedNs = 0;
+    qint64 numNodes = 0; // per iteration
+    bool isGood = true;
+};
+
+SyntheticMeasurement measureInMemory(const SimpleParser::Data& data, const QString& text, int iterations, bool isTraced)
+{
+    SyntheticMeasurement result;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        SimpleParser parser(data);
+        std::unique_ptr<EventLogger> logger;
+        if (isTraced) {
+            logger.reset(new EventLogger);
+            logger->installInterpreter(SimpleParserEvent::getInterpreter());
+        }
+        Tree tree;
+        timer.start();
+        bool isGood = parser.performParsing(text, tree, logger.get());
+        result.elapsedNs += timer.nsecsElapsed();
+        result.numNodes = tree.getNumNodes();
+        if (!isGood) {
+            result.isGood = false;
+        }
+    }
+    return result;
+}
+
+SyntheticMeasurement measureStreaming(const SimpleParser::Data& data, const QString& filePath, int iterations)
+{
+    SyntheticMeasurement result;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        SimpleParser parser(data);
+        QFile f(filePath);
+        if (!f.open(QIODevice::ReadOnly)) {
+            result.isGood = false;
+            return result;
+        }
+        qint64 numNodes = 1; // root
+        timer.start();
+        bool isGood = parser.performStreamingParsing(&f, [&numNodes](Tree& record) -> bool {
+            numNodes += record.getNumNodes() - 1;
+            return true;
+        });
+        result.elapsedNs += timer.nsecsElapsed();
+        result.numNodes = numNodes;
+        if (!isGood) {
+            result.isGood = false;
+        }
+    }
+    return result;
+}
+
+void writeSyntheticRow(QTextStream& out, const QString& grammar, qint64 size, const QString& mode, int iterations, const SyntheticMeasurement& m)
+{
+    double seconds = static_cast<double>(m.elapsedNs) / 1e9;
+    double mbPerSecond = (seconds > 0)? static_cast<double>(size) * iterations / 1e6 / seconds : 0;
+    double nodesPerSecond = (seconds > 0)? static_cast<double>(m.numNodes) * iterations / seconds : 0;
+    out << grammar << '\t'
+        << size << '\t'
+        << mode << '\t'
+        << iterations << '\t'
+        << mbPerSecond << '\t'
+        << nodesPerSecond << '\t'
+        << m.numNodes << '\t'
+        << getPeakRSS() << '\n';
+    out.flush();
+}
+
+// the row is kept so that every size has both modes in the table
+void writeSkippedRow(QTextStream& out, const QString& grammar, qint64 size, const QString& mode)
+{
+    out << grammar << '\t'
+        << size << '\t'
+        << mode << '\t'
+        << 0 << '\t'
+        << "skipped" << '\t'
+        << "skipped" << '\t'
+        << "skipped" << '\t'
+        << getPeakRSS() << '\n';
+    out.flush();
+}
+
+} // end of anonymous namespace
+
+qint64 ParserBenchmark::parseSize(const QString& str)
+{
+    QString s = str.trimmed().toUpper();
+    if (s.isEmpty())
+        return -1;
+    qint64 multiplier = 1;
+    switch (s.at(s.length() - 1).unicode()) {
+    default: break;
+    case 'K': multiplier = Q_INT64_C(1) << 10; break;
+    case 'M': multiplier = Q_INT64_C(1) << 20; break;
+    case 'G': multiplier = Q_INT64_C(1) << 30; break;
+    }
+    if (multiplier > 1) {
+        s.chop(1);
+    }
+    bool isGood = false;
+    qint64 value = s.toLongLong(&isGood);
+    if (!isGood || value <= 0)
+        return -1;
+    return value * multiplier;
+}
+
+int ParserBenchmark::runSynthetic(const SyntheticOptions& options)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QStringList grammarNames = options.grammars;
+    if (grammarNames.isEmpty()) {
+        grammarNames = QStringList({
+            QStringLiteral("literal-10"), QStringLiteral("literal-1000"),
+            QStringLiteral("regex-10"), QStringLiteral("regex-100"),
+            QStringLiteral("nesting-4"), QStringLiteral("nesting-32"),
+            QStringLiteral("classbased-8")
+        });
+    }
+    QList<qint64> sizes = options.inputSizes;
+    if (sizes.isEmpty()) {
+        sizes = QList<qint64>({Q_INT64_C(1) << 10, Q_INT64_C(1) << 16, Q_INT64_C(1) << 20, Q_INT64_C(1) << 24, Q_INT64_C(1) << 28, Q_INT64_C(1) << 30});
+    }
+
+    int retVal = 0;
+    out << "grammar\tbytes\tmode\titerations\tMB/s\tnodes/s\tnodes\tpeakRSS(KiB)" << '\n';
+    for (const QString& grammarName : grammarNames) {
+        SyntheticGrammar g;
+        if (!makeSyntheticGrammar(grammarName, g)) {
+            err << "Unknown synthetic grammar " << grammarName << '\n';
+            retVal = 1;
+            continue;
+        }
+        for (qint64 size : sizes) {
+            if (size <= MAX_IN_MEMORY_INPUT_SIZE) {
+                QString text;
+                text.reserve(static_cast<int>(size) + 128);
+                for (qint64 line = 0; text.length() < size; ++line) {
+                    g.appendLine(text, line);
+                }
+                SyntheticMeasurement traced = measureInMemory(g.data, text, options.iterations, true);
+                writeSyntheticRow(out, grammarName, text.length(), QStringLiteral("traced"), options.iterations, traced);
+                SyntheticMeasurement untraced = measureInMemory(g.data, text, options.iterations, false);
+                writeSyntheticRow(out, grammarName, text.length(), QStringLiteral("untraced"), options.iterations, untraced);
+                if (!traced.isGood || !untraced.isGood) {
+                    err << "Parsing failed for " << grammarName << " at " << size << " bytes" << '\n';
+                    retVal = 1;
+                }
+            } else {
+                // generate to a file in chunks; the text is pure ASCII so characters are bytes
+                QTemporaryFile file;
+                if (!file.open()) {
+                    err << "Cannot create temporary file for " << size << " bytes of input" << '\n';
+                    retVal = 1;
+                    continue;
+                }
+                qint64 written = 0;
+                QString chunk;
+                for (qint64 line = 0; written < size; ++line) {
+                    g.appendLine(chunk, line);
+                    if (chunk.length() >= (1 << 20)) {
+                        written += file.write(chunk.toLatin1());
+                        chunk.clear();
+                    }
+                }
+                written += file.write(chunk.toLatin1());
+                file.close();
+                // the event log for this much text does not fit in memory; traced parsing needs the whole text in a QString anyway
+                writeSkippedRow(out, grammarName, written, QStringLiteral("traced"));
+                err << "Traced run skipped for " << grammarName << " at " << size << " bytes: above the in-memory limit of "
+                    << MAX_IN_MEMORY_INPUT_SIZE << " bytes" << '\n';
+                SyntheticMeasurement untraced = measureStreaming(g.data, file.fileName(), options.iterations);
+                writeSyntheticRow(out, grammarName, written, QStringLiteral("untraced-streaming"), options.iterations, untraced);
+                if (!untraced.isGood) {
+                    err << "Parsing failed for " << grammarName << " at " << size << " bytes" << '\n';
+                    retVal = 1;
+                }
+            }
+        }
+    }
+    return retVal;
+}
+
+// ----------------------------------------------------------------------------
+// pattern engine comparison
+
+namespace {
+
+struct EngineRun {
+    Tree tree;
+    SimpleParser::ProfileReport report;
+    bool isGood = true;
+};
+
+EngineRun runEngine(const SimpleParser::Data& data, const QString& text, int iterations, SimpleParser::PatternEngine engine)
+{
+    EngineRun result;
+    SimpleParser parser(data);
+    parser.setPatternEngine(engine);
+    parser.setProfilingEnabled(true);
+    for (int i = 0; i < iterations; ++i) {
+        Tree tree;
+        if (!parser.performParsing(text, tree)) {
+            result.isGood = false;
+        }
+        result.tree.swap(tree);
+    }
+    result.report = parser.getProfileReport();
+    return result;
+}
+
+// index of the first node (in pre-order) that differs; -1 if trees are the same
+int findFirstDifference(const Tree& lhs, const Tree& rhs)
+{
+    int numNodes = qMin(lhs.getNumNodes(), rhs.getNumNodes());
+    for (int i = 0; i < numNodes; ++i) {
+        const Tree::Node& l = lhs.getNode(i);
+        const Tree::Node& r = rhs.getNode(i);
+        if (l.typeName != r.typeName || l.keyList != r.keyList || l.valueList != r.valueList
+                || l.offsetFromParent != r.offsetFromParent || l.offsetToChildren != r.offsetToChildren) {
+            return i;
+        }
+    }
+    if (lhs.getNumNodes() != rhs.getNumNodes())
+        return numNodes;
+    return -1;
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::compareEngines(const Options& options)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    std::unique_ptr<FileBackedObject> obj(FileBackedObject::open(options.parserPath, nullptr));
+    SimpleParserObject* parserObj = qobject_cast<SimpleParserObject*>(obj.get());
+    if (!parserObj) {
+        err << "Cannot load parser from " << options.parserPath << '\n';
+        return 1;
+    }
+    const SimpleParser::Data& data = parserObj->getData();
+
+    int retVal = 0;
+    out << "input\trule\tpattern\ttype\tattempts\tsuccesses(hole-filling)\tsuccesses(sequential)\thole-filling(ns)\tsequential(ns)\tsequential/hole-filling" << '\n';
+    for (const QString& path : options.inputPaths) {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            err << "Cannot open input " << path << '\n';
+            retVal = 1;
+            continue;
+        }
+        QString text = QString::fromUtf8(f.readAll());
+        f.close();
+        QString inputName = QFileInfo(path).fileName();
+
+        EngineRun holeFilling = runEngine(data, text, options.iterations, SimpleParser::PatternEngine::HoleFilling);
+        EngineRun sequential = runEngine(data, text, options.iterations, SimpleParser::PatternEngine::Sequential);
+        if (holeFilling.isGood != sequential.isGood) {
+            err << inputName << ": parsing " << (holeFilling.isGood? "fails" : "succeeds") << " with the sequential engine only" << '\n';
+            retVal = 1;
+        } else if (holeFilling.isGood) {
+            int diffNode = findFirstDifference(holeFilling.tree, sequential.tree);
+            if (diffNode >= 0) {
+                err << inputName << ": trees differ starting at node " << diffNode << '\n';
+                retVal = 1;
+            }
+        }
+
+        // both reports list the patterns in the same order
+        Q_ASSERT(holeFilling.report.patterns.size() == sequential.report.patterns.size());
+        for (int i = 0, n = holeFilling.report.patterns.size(); i < n; ++i) {
+            const auto& lhs = holeFilling.report.patterns.at(i);
+            const auto& rhs = sequential.report.patterns.at(i);
+            if (lhs.numAttempts == 0 && rhs.numAttempts == 0)
+                continue;
+            out << inputName << '\t'
+                << lhs.ruleNodeName << '\t'
+                << lhs.patternIndex << '\t'
+                << lhs.typeName << '\t'
+                << lhs.numAttempts << '\t'
+                << lhs.numSuccesses << '\t'
+                << rhs.numSuccesses << '\t'
+                << lhs.totalTimeNs << '\t'
+                << rhs.totalTimeNs << '\t'
+                << (lhs.totalTimeNs > 0? static_cast<double>(rhs.totalTimeNs) / static_cast<double>(lhs.totalTimeNs) : 0) << '\n';
+        }
+        out << inputName << "\t(total)\t\t\t\t\t\t"
+            << holeFilling.report.totalParseTimeNs << '\t'
+            << sequential.report.totalParseTimeNs << '\t'
+            << (holeFilling.report.totalParseTimeNs > 0? static_cast<double>(sequential.report.totalParseTimeNs) / static_cast<double>(holeFilling.report.totalParseTimeNs) : 0) << '\n';
+    }
+    return retVal;
+}
+
+// ----------------------------------------------------------------------------
+// deep tree stress test
+
+namespace {
+
+const QString DEEP_TREE_ROOT_TYPE = QStringLiteral("Root");
+const QString DEEP_TREE_LEVEL_TYPE = QStringLiteral("Level");
+
+Tree::LocalValueExpression makeLiteralExpression(const QString& str)
+{
+    Tree::LocalValueExpression expr;
+    expr.ty = Tree::LocalValueExpression::ValueType::Literal;
+    expr.str = str;
+    return expr;
+}
+
+void writeStressRow(QTextStream& out, const QString& stage, qint64 numNodes, qint64 elapsedNs)
+{
+    out << stage << '\t'
+        << numNodes << '\t'
+        << static_cast<double>(elapsedNs) / 1e6 << '\t'
+        << getPeakRSS() << '\n';
+    out.flush();
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::stressDeepTree(int depth)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (depth <= 0) {
+        err << "Invalid depth " << depth << '\n';
+        return 1;
+    }
+    const int expectedNumNodes = depth + 1; // root + one node per level
+
+    out << "stage\tnodes\tms\tpeakRSS(KiB)" << '\n';
+    QElapsedTimer timer;
+
+    // each level node is the only child of the node before it
+    timer.start();
+    Tree tree;
+    {
+        PreOrderTreeBuilder builder;
+        builder.reserve(expectedNumNodes);
+        int parent = builder.addNode(-1);
+        builder.getNode(parent).typeName = DEEP_TREE_ROOT_TYPE;
+        for (int i = 0; i < depth; ++i) {
+            int nodeIndex = builder.addNode(parent);
+            Tree::Node& node = builder.getNode(nodeIndex);
+            node.typeName = DEEP_TREE_LEVEL_TYPE;
+            node.keyList.push_back(QStringLiteral("level"));
+            node.valueList.push_back(QString::number(i));
+            parent = nodeIndex;
+        }
+        builder.takeTree(tree);
+    }
+    writeStressRow(out, QStringLiteral("build"), tree.getNumNodes(), timer.nsecsElapsed());
+    if (tree.getNumNodes() != expectedNumNodes) {
+        err << "Built tree has " << tree.getNumNodes() << " nodes; expecting " << expectedNumNodes << '\n';
+        return 1;
+    }
+
+    // pass through every node; this walks the whole tree without rule overhead
+    SimpleTreeTransform::Data transformData;
+    transformData.defaultAction = SimpleTreeTransform::PredefinedAction::PassThrough;
+    SimpleTreeTransform transform(transformData);
+    timer.start();
+    Tree transformed;
+    bool isTransformGood = transform.performTransform(tree, transformed, QList<const Tree*>());
+    writeStressRow(out, QStringLiteral("transform"), transformed.getNumNodes(), timer.nsecsElapsed());
+    if (!isTransformGood) {
+        err << "Transform failed" << '\n';
+        return 1;
+    }
+    if (transformed.getNumNodes() != expectedNumNodes) {
+        err << "Transformed tree has " << transformed.getNumNodes() << " nodes; expecting " << expectedNumNodes << '\n';
+        return 1;
+    }
+
+    // each level is written as a pair of parentheses around its child
+    SimpleTextGenerator::Data generatorData;
+    generatorData.unknownNodePolicy = SimpleTextGenerator::UnknownNodePolicy::Error;
+    generatorData.expansions.insert(DEEP_TREE_ROOT_TYPE, SimpleTextGenerator::NodeExpansionRule());
+    SimpleTextGenerator::NodeExpansionRule levelRule;
+    levelRule.header.push_back(makeLiteralExpression(QStringLiteral("(")));
+    levelRule.tail.push_back(makeLiteralExpression(QStringLiteral(")")));
+    generatorData.expansions.insert(DEEP_TREE_LEVEL_TYPE, levelRule);
+
+    timer.start();
+    QString text;
+    SimpleTextGenerator generator(generatorData);
+    bool isGenerationGood = generator.performGeneration(transformed, text);
+    writeStressRow(out, QStringLiteral("generate"), transformed.getNumNodes(), timer.nsecsElapsed());
+    if (!isGenerationGood) {
+        err << "Text generation failed" << '\n';
+        return 1;
+    }
+    const qint64 expectedLength = static_cast<qint64>(depth) * 2;
+    if (text.length() != expectedLength) {
+        err << "Generated text has " << text.length() << " characters; expecting " << expectedLength << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// transform memory benchmark
+
+namespace {
+
+struct TransformMemoryRun {
+    Tree tree;
+    qint64 elapsedNs = 0;
+    qint64 peakRSS = -1;
+    qint64 numErrors = 0;
+    qint64 retainedBytes = 0; // estimated size of provenance and errors kept after the transform
+};
+
+TransformMemoryRun runTransformMemoryConfig(const SimpleTreeTransform::Data& data, const Tree& src,
+                                            SimpleTreeTransform::TransformOptions::ErrorRecording recording, bool isProvenanceKept)
+{
+    TransformMemoryRun result;
+    SimpleTreeTransform transform(data);
+    SimpleTreeTransform::TransformOptions options;
+    options.errorRecording = recording;
+    transform.setTransformOptions(options);
+
+    QVector<SimpleTreeTransform::NodeProvenance> provenance;
+    QVector<SimpleTreeTransform::TransformError> errors;
+    QElapsedTimer timer;
+    timer.start();
+    // errors are requested, so the transform is expected to fail
+    transform.performTransform(src, result.tree, QList<const Tree*>(), isProvenanceKept? &provenance : nullptr, &errors);
+    result.elapsedNs = timer.nsecsElapsed();
+    result.peakRSS = getPeakRSS();
+    result.numErrors = errors.size();
+    result.retainedBytes = static_cast<qint64>(provenance.capacity()) * static_cast<qint64>(sizeof(SimpleTreeTransform::NodeProvenance))
+                         + static_cast<qint64>(errors.capacity()) * static_cast<qint64>(sizeof(SimpleTreeTransform::TransformError));
+    for (const auto& err : errors) {
+        result.retainedBytes += (err.unrecognizedNodeType.size() + err.evalFailData.key.size() + err.evalFailData.value.size()) * static_cast<qint64>(sizeof(QChar));
+    }
+    return result;
+}
+
+void writeTransformMemoryRow(QTextStream& out, const QString& config, const TransformMemoryRun& run)
+{
+    out << config << '\t'
+        << run.tree.getNumNodes() << '\t'
+        << run.numErrors << '\t'
+        << static_cast<double>(run.elapsedNs) / 1e6 << '\t'
+        << run.retainedBytes / 1024 << '\t'
+        << run.peakRSS << '\n';
+    out.flush();
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::runTransformMemory(const QString& config, int numNodes)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (numNodes <= 0) {
+        err << "Invalid node count " << numNodes << '\n';
+        return 1;
+    }
+    bool isFull = (config == QStringLiteral("full"));
+    if (!isFull && config != QStringLiteral("lean")) {
+        err << "Unknown configuration " << config << " (expecting lean or full)" << '\n';
+        return 1;
+    }
+
+    // a root with numNodes children; "Item" nodes pass through and "Junk" nodes have no rule and raise an error
+    const QString itemType = QStringLiteral("Item");
+    Tree tree;
+    {
+        PreOrderTreeBuilder builder;
+        builder.reserve(numNodes + 1);
+        int root = builder.addNode(-1);
+        builder.getNode(root).typeName = QStringLiteral("Root");
+        for (int i = 0; i < numNodes; ++i) {
+            int nodeIndex = builder.addNode(root);
+            Tree::Node& node = builder.getNode(nodeIndex);
+            node.typeName = (i % 2 == 0)? itemType : QStringLiteral("Junk%1").arg(i);
+            node.keyList.push_back(QStringLiteral("index"));
+            node.valueList.push_back(QString::number(i));
+        }
+        builder.takeTree(tree);
+    }
+
+    SimpleTreeTransform::Data data;
+    data.defaultAction = SimpleTreeTransform::PredefinedAction::PassThrough;
+    data.isUnrecognizedNodeUseDefaultAction = false;
+    data.unrecognizedNodeActionOverride = SimpleTreeTransform::PredefinedAction::Error;
+    data.nodeTypeToRuleList.insert(itemType, QVector<SimpleTreeTransform::NodeTransformRule>({SimpleTreeTransform::NodeTransformRule()}));
+    data.nodeTypeToRuleList.insert(QStringLiteral("Root"), QVector<SimpleTreeTransform::NodeTransformRule>({SimpleTreeTransform::NodeTransformRule()}));
+
+    out << "config\tnodes\terrors\tms\tretained(KiB)\tpeakRSS(KiB)" << '\n';
+    out << "(input)\t" << tree.getNumNodes() << "\t\t\t\t" << getPeakRSS() << '\n';
+    TransformMemoryRun run = runTransformMemoryConfig(data, tree,
+                                                      isFull? SimpleTreeTransform::TransformOptions::ErrorRecording::All
+                                                            : SimpleTreeTransform::TransformOptions::ErrorRecording::CodeOnly,
+                                                      isFull);
+    writeTransformMemoryRow(out, config, run);
+
+    // the root and the "Item" nodes are kept; every "Junk" node raises an error
+    int numJunk = numNodes / 2;
+    if (run.tree.getNumNodes() != numNodes - numJunk + 1 || run.numErrors != numJunk) {
+        err << "Unexpected result: " << run.tree.getNumNodes() << " nodes and " << run.numErrors << " errors" << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// transform consistency checks on generated trees
+
+namespace {
+
+const QStringList CHECK_NODE_TYPES = {QStringLiteral("A"), QStringLiteral("B"), QStringLiteral("C"), QStringLiteral("D")};
+const QString CHECK_KEY = QStringLiteral("k");
+const QString CHECK_MISSING_KEY = QStringLiteral("missing"); // never in a generated tree; reading it fails an evaluation
+const int CHECK_NUM_VALUES = 3;
+const int CHECK_MAX_NODES = 40;
+
+// uniform in [0, n)
+int pick(std::mt19937& rng, int n)
+{
+    return static_cast<int>(rng() % static_cast<unsigned>(n));
+}
+
+Tree::LocalValueExpression makeKeyValueExpression(const QString& key)
+{
+    Tree::LocalValueExpression expr;
+    expr.ty = Tree::LocalValueExpression::ValueType::KeyValue;
+    expr.str = key;
+    return expr;
+}
+
+Tree::GeneralValueExpression makeGeneralExpression(const Tree::LocalValueExpression& local)
+{
+    Tree::GeneralValueExpression expr;
+    Tree::GeneralValueExpression::Branch branch;
+    branch.value.defaultValue = local;
+    expr.branches.push_back(branch);
+    return expr;
+}
+
+// a literal value, a copy of the value of the node, or (rarely) a value that cannot be evaluated
+Tree::LocalValueExpression makeRandomValueExpression(std::mt19937& rng)
+{
+    switch (pick(rng, 8)) {
+    case 0: return makeKeyValueExpression(CHECK_MISSING_KEY);
+    case 1:
+    case 2:
+    case 3: return makeKeyValueExpression(CHECK_KEY);
+    default: return makeLiteralExpression(QString::number(pick(rng, CHECK_NUM_VALUES)));
+    }
+}
+
+Tree makeRandomTree(std::mt19937& rng)
+{
+    PreOrderTreeBuilder builder;
+    // nodes on the path from the root to the last added node; a new node goes under one of them
+    QVector<int> path;
+    int numNodes = 1 + pick(rng, CHECK_MAX_NODES);
+    for (int i = 0; i < numNodes; ++i) {
+        int parent = -1;
+        if (i > 0) {
+            path.resize(1 + pick(rng, path.size()));
+            parent = path.last();
+        }
+        int nodeIndex = builder.addNode(parent);
+        Tree::Node& node = builder.getNode(nodeIndex);
+        node.typeName = CHECK_NODE_TYPES.at(pick(rng, CHECK_NODE_TYPES.size()));
+        node.keyList.push_back(CHECK_KEY);
+        node.valueList.push_back(QString::number(pick(rng, CHECK_NUM_VALUES)));
+        path.push_back(nodeIndex);
+    }
+    Tree tree;
+    builder.takeTree(tree);
+    return tree;
+}
+
+SimpleTreeTransform::PredefinedAction makeRandomPredefinedAction(std::mt19937& rng)
+{
+    // mostly pass through so that the later passes have something to work on
+    switch (pick(rng, 6)) {
+    case 0: return SimpleTreeTransform::PredefinedAction::Remove;
+    case 1: return SimpleTreeTransform::PredefinedAction::Error;
+    default: return SimpleTreeTransform::PredefinedAction::PassThrough;
+    }
+}
+
+// rules only read the node they are applied on
+SimpleTreeTransform::Data makeRandomLocalTransform(std::mt19937& rng)
+{
+    using Rule = SimpleTreeTransform::NodeTransformRule;
+    SimpleTreeTransform::Data data;
+    data.defaultAction = makeRandomPredefinedAction(rng);
+    data.isUnrecognizedNodeUseDefaultAction = (pick(rng, 2) == 0);
+    data.unrecognizedNodeActionOverride = makeRandomPredefinedAction(rng);
+    for (const QString& nodeType : CHECK_NODE_TYPES) {
+        if (pick(rng, 4) == 0)
+            continue;
+        QVector<Rule> rules;
+        for (int ruleIndex = 0, numRules = 1 + pick(rng, 2); ruleIndex < numRules; ++ruleIndex) {
+            Rule rule;
+            rule.ty = static_cast<Rule::TransformType>(pick(rng, 4));
+            if (pick(rng, 2) == 0) {
+                Tree::Predicate pred;
+                pred.ty = Tree::Predicate::PredicateType::ValueEqual;
+                pred.isInvert = (pick(rng, 2) == 0);
+                pred.v1.defaultValue = makeKeyValueExpression(CHECK_KEY);
+                pred.v2.defaultValue = makeLiteralExpression(QString::number(pick(rng, CHECK_NUM_VALUES)));
+                rule.predicates.push_back(pred);
+            }
+            switch (rule.ty) {
+            case Rule::TransformType::PassThrough:
+            case Rule::TransformType::Remove:
+                break;
+            case Rule::TransformType::Replace: {
+                // the first template is at root level; later ones can also be (which matters on the root)
+                for (int i = 0, n = 1 + pick(rng, 3); i < n; ++i) {
+                    SimpleTreeTransform::SubTreeNodeTemplate nodeTemplate;
+                    nodeTemplate.parentIndex = (i == 0)? -1 : pick(rng, i + 1) - 1;
+                    nodeTemplate.ty = makeGeneralExpression(makeLiteralExpression(CHECK_NODE_TYPES.at(pick(rng, CHECK_NODE_TYPES.size()))));
+                    SimpleTreeTransform::KeyValueExpressionPair kvPair;
+                    kvPair.key = makeGeneralExpression(makeLiteralExpression(CHECK_KEY));
+                    kvPair.value = makeGeneralExpression(makeRandomValueExpression(rng));
+                    nodeTemplate.kvList.push_back(kvPair);
+                    rule.nodeTemplates.push_back(nodeTemplate);
+                }
+            }break;
+            case Rule::TransformType::Modify: {
+                SimpleTreeTransform::KeyValueExpressionPair patch;
+                if (pick(rng, 2) == 0) {
+                    // change the type
+                    patch.key = makeGeneralExpression(makeLiteralExpression(QString()));
+                    patch.value = makeGeneralExpression(makeLiteralExpression(CHECK_NODE_TYPES.at(pick(rng, CHECK_NODE_TYPES.size()))));
+                } else {
+                    patch.key = makeGeneralExpression(makeLiteralExpression(CHECK_KEY));
+                    patch.value = makeGeneralExpression(makeRandomValueExpression(rng));
+                }
+                rule.modifications.push_back(patch);
+            }break;
+            }
+            rules.push_back(rule);
+        }
+        data.nodeTypeToRuleList.insert(nodeType, rules);
+    }
+    return data;
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::checkTransformChain(int numCases)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (numCases <= 0) {
+        err << "Invalid case count " << numCases << '\n';
+        return 1;
+    }
+
+    int numFailedCases = 0;
+    for (int caseIndex = 0; caseIndex < numCases; ++caseIndex) {
+        // each case is seeded by its index so that a failure can be reproduced alone
+        std::mt19937 rng(static_cast<std::mt19937::result_type>(caseIndex));
+        Tree tree = makeRandomTree(rng);
+        QVector<SimpleTreeTransform::Data> passData;
+        for (int i = 0, n = 2 + pick(rng, 3); i < n; ++i) {
+            passData.push_back(makeRandomLocalTransform(rng));
+        }
+
+        SimpleTreeTransformChain chain(passData);
+        if (chain.getNumWalks() != 1) {
+            err << "case " << caseIndex << ": " << passData.size() << " local passes are not fused into one walk" << '\n';
+            numFailedCases += 1;
+            continue;
+        }
+        Tree fused;
+        bool isFusedGood = chain.performTransform(tree, fused, QVector<QList<const Tree*>>(passData.size()));
+
+        Tree expected = tree;
+        bool isExpectedGood = true;
+        for (const auto& d : passData) {
+            Tree result;
+            isExpectedGood = SimpleTreeTransform(d).performTransform(expected, result, QList<const Tree*>()) && isExpectedGood;
+            expected.swap(result);
+        }
+
+        if (isFusedGood != isExpectedGood) {
+            err << "case " << caseIndex << ": the fused walk " << (isFusedGood? "succeeds" : "fails") << " while pass by pass does not" << '\n';
+            numFailedCases += 1;
+            continue;
+        }
+        int diffNode = findFirstDifference(fused, expected);
+        if (diffNode >= 0) {
+            err << "case " << caseIndex << ": trees differ starting at node " << diffNode << '\n';
+            numFailedCases += 1;
+        }
+    }
+    out << numCases - numFailedCases << " of " << numCases << " cases match" << '\n';
+    return (numFailedCases == 0)? 0 : 1;
+}
+
+// ----------------------------------------------------------------------------
+// incremental transform checks on generated edits
+
+namespace {
+
+// like makeRandomLocalTransform(), but rules may also read descendants (predicates and skipped nodes)
+// and rarely the parent, so that update() has to widen or give up on the dirty regions
+SimpleTreeTransform::Data makeRandomIncrementalTransform(std::mt19937& rng)
+{
+    SimpleTreeTransform::Data data = makeRandomLocalTransform(rng);
+    // node types are visited in a fixed order; hash order changes from run to run
+    for (const QString& nodeType : CHECK_NODE_TYPES) {
+        auto iter = data.nodeTypeToRuleList.find(nodeType);
+        if (iter == data.nodeTypeToRuleList.end())
+            continue;
+        for (auto& rule : iter.value()) {
+            Tree::NodeTraverseStep childStep;
+            childStep.destination = Tree::NodeTraverseStep::StepDestination::Child;
+            childStep.childTypeFilter = CHECK_NODE_TYPES.at(pick(rng, CHECK_NODE_TYPES.size()));
+            switch (pick(rng, 8)) {
+            case 0:
+            case 1: {
+                Tree::Predicate pred;
+                pred.ty = Tree::Predicate::PredicateType::NodeExist;
+                pred.isInvert = (pick(rng, 2) == 0);
+                pred.nodeTest.steps.push_back(childStep);
+                rule.predicates.push_back(pred);
+            }break;
+            case 2: {
+                rule.skipNodes.push_back(QVector<Tree::NodeTraverseStep>({childStep}));
+            }break;
+            default: break;
+            }
+            if (pick(rng, 32) == 0) {
+                // reads the value of the parent; any node with this rule list makes update() start over
+                Tree::Predicate pred;
+                pred.ty = Tree::Predicate::PredicateType::ValueEqual;
+                pred.v1.es = Tree::SingleValueExpression::EvaluateStrategy::TraverseWithFallback;
+                pred.v1.defaultValue = makeLiteralExpression(QString());
+                pred.v1.traversal.push_back(Tree::NodeTraverseStep());
+                pred.v1.exprAtDestinationNode = makeKeyValueExpression(CHECK_KEY);
+                pred.v2.defaultValue = makeLiteralExpression(QString::number(pick(rng, CHECK_NUM_VALUES)));
+                rule.predicates.push_back(pred);
+            }
+        }
+    }
+    return data;
+}
+
+struct TreeEdit {
+    enum class Kind {
+        ChangeValue,
+        ChangeType,
+        AddChild, // a leaf after the last child
+        RemoveSubtree
+    };
+    Kind kind = Kind::ChangeValue;
+    int nodeIndex = 0;
+    QString typeName; // for ChangeType and AddChild
+    QString value; // for ChangeValue and AddChild
+};
+
+void copyEditedSubtree(const Tree& src, int srcIndex, const TreeEdit& edit, PreOrderTreeBuilder& builder, int parent)
+{
+    const Tree::Node& srcNode = src.getNode(srcIndex);
+    int nodeIndex = builder.addNode(parent);
+    {
+        // the reference is invalidated when more nodes are added
+        Tree::Node& node = builder.getNode(nodeIndex);
+        node.typeName = srcNode.typeName;
+        node.keyList = srcNode.keyList;
+        node.valueList = srcNode.valueList;
+        if (srcIndex == edit.nodeIndex) {
+            if (edit.kind == TreeEdit::Kind::ChangeValue) {
+                node.valueList.front() = edit.value;
+            } else if (edit.kind == TreeEdit::Kind::ChangeType) {
+                node.typeName = edit.typeName;
+            }
+        }
+    }
+    for (int offset : srcNode.offsetToChildren) {
+        int child = srcIndex + offset;
+        if (edit.kind == TreeEdit::Kind::RemoveSubtree && child == edit.nodeIndex)
+            continue;
+        copyEditedSubtree(src, child, edit, builder, nodeIndex);
+    }
+    if (edit.kind == TreeEdit::Kind::AddChild && srcIndex == edit.nodeIndex) {
+        Tree::Node& node = builder.getNode(builder.addNode(nodeIndex));
+        node.typeName = edit.typeName;
+        node.keyList.push_back(CHECK_KEY);
+        node.valueList.push_back(edit.value);
+    }
+}
+
+Tree makeRandomEdit(std::mt19937& rng, const Tree& tree)
+{
+    TreeEdit edit;
+    edit.kind = static_cast<TreeEdit::Kind>(pick(rng, 4));
+    edit.nodeIndex = pick(rng, tree.getNumNodes());
+    if (edit.kind == TreeEdit::Kind::RemoveSubtree && edit.nodeIndex == 0) {
+        // the root stays
+        edit.kind = TreeEdit::Kind::ChangeValue;
+    }
+    edit.typeName = CHECK_NODE_TYPES.at(pick(rng, CHECK_NODE_TYPES.size()));
+    edit.value = QString::number(pick(rng, CHECK_NUM_VALUES));
+    PreOrderTreeBuilder builder;
+    copyEditedSubtree(tree, 0, edit, builder, -1);
+    Tree result;
+    builder.takeTree(result);
+    return result;
+}
+
+bool isSameProvenance(const QVector<SimpleTreeTransform::NodeProvenance>& lhs, const QVector<SimpleTreeTransform::NodeProvenance>& rhs)
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    for (int i = 0, n = lhs.size(); i < n; ++i) {
+        if (lhs.at(i).srcNodeIndex != rhs.at(i).srcNodeIndex || lhs.at(i).patternIndex != rhs.at(i).patternIndex)
+            return false;
+    }
+    return true;
+}
+
+bool isSameErrors(const QVector<SimpleTreeTransform::TransformError>& lhs, const QVector<SimpleTreeTransform::TransformError>& rhs)
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    for (int i = 0, n = lhs.size(); i < n; ++i) {
+        const auto& l = lhs.at(i);
+        const auto& r = rhs.at(i);
+        if (l.srcNodeIndex != r.srcNodeIndex || l.patternIndex != r.patternIndex || l.cause != r.cause
+                || l.unrecognizedNodeType != r.unrecognizedNodeType || l.modificationIndex != r.modificationIndex
+                || l.evalFailData.key != r.evalFailData.key || l.evalFailData.value != r.evalFailData.value
+                || l.evalFailData.keyValueIndex != r.evalFailData.keyValueIndex
+                || l.evalFailData.isKeyGood != r.evalFailData.isKeyGood || l.evalFailData.isValueGood != r.evalFailData.isValueGood)
+            return false;
+    }
+    return true;
+}
+
+} // end of anonymous namespace
+
+int ParserBenchmark::checkIncrementalTransform(int numCases)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (numCases <= 0) {
+        err << "Invalid case count " << numCases << '\n';
+        return 1;
+    }
+
+    const int numEditsPerCase = 8;
+    int numFailedCases = 0;
+    qint64 numTransformedNodes = 0;
+    qint64 numResetNodes = 0;
+    for (int caseIndex = 0; caseIndex < numCases; ++caseIndex) {
+        // each case is seeded by its index so that a failure can be reproduced alone
+        std::mt19937 rng(static_cast<std::mt19937::result_type>(caseIndex));
+        Tree tree = makeRandomTree(rng);
+        SimpleTreeTransform transform(makeRandomIncrementalTransform(rng));
+
+        IncrementalTreeTransform incremental(transform);
+        incremental.reset(tree, QList<const Tree*>());
+        for (int editIndex = 0; editIndex < numEditsPerCase; ++editIndex) {
+            tree = makeRandomEdit(rng, tree);
+            bool isUpdateGood = incremental.update(tree);
+            IncrementalTreeTransform fresh(transform);
+            bool isResetGood = fresh.reset(tree, QList<const Tree*>());
+            numTransformedNodes += incremental.getNumTransformedNodes();
+            numResetNodes += fresh.getNumTransformedNodes();
+
+            const char* mismatch = nullptr;
+            int diffNode = findFirstDifference(incremental.getOutput(), fresh.getOutput());
+            if (isUpdateGood != isResetGood) {
+                mismatch = "success";
+            } else if (diffNode >= 0) {
+                mismatch = "output";
+            } else if (!isSameProvenance(incremental.getProvenance(), fresh.getProvenance())) {
+                mismatch = "provenance";
+            } else if (!isSameErrors(incremental.getErrors(), fresh.getErrors())) {
+                mismatch = "errors";
+            }
+            if (mismatch) {
+                err << "case " << caseIndex << ", edit " << editIndex << ": update() and reset() differ in " << mismatch;
+                if (diffNode >= 0) {
+                    err << " starting at node " << diffNode;
+                }
+                err << '\n';
+                numFailedCases += 1;
+                break;
+            }
+        }
+    }
+    out << numCases - numFailedCases << " of " << numCases << " cases match" << '\n';
+    out << "update() transformed " << numTransformedNodes << " of " << numResetNodes << " nodes" << '\n';
+    return (numFailedCases == 0)? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#ifndef PARSERBENCHMARK_H
+#define PARSERBENCHMARK_H
+
+#include <QString>
+#include <QStringList>
+
+// command line benchmark for SimpleParser; results are printed to stdout
+namespace ParserBenchmark {
+
+struct Options {
+    QString parserPath;
+    QStringList inputPaths;
+    int iterations = 10;
+};
+
+/**
+ * @brief run load the parser and input files, parse each input in all measured modes and print the throughput
+ *
+ * The logging overhead is measured against untraced parsing without the untraced-only fast paths;
+ * the gain from the fast paths is reported in a separate column.
+ * @return 0 on success, non-zero if any file cannot be loaded or any parse fails
+ */
+int run(const Options& options);
+
+/**
+ * @brief compareEngines parse each input with both pattern engines, check that the trees are the same
+ * and print the time spent on each pattern by each engine
+ * @return 0 if all inputs give the same result, non-zero otherwise
+ */
+int compareEngines(const Options& options);
+
+// benchmark on generated grammars and inputs; does not need any file
+struct SyntheticOptions {
+    // grammar families: literal-<n>, regex-<n>, nesting-<depth>, classbased-<n>; empty for the default set
+    QStringList grammars;
+    QList<qint64> inputSizes; // in bytes; empty for the default set (1 KiB to 1 GiB)
+    int iterations = 10;
+};
+
+/**
+ * @brief runSynthetic generate each grammar and input size, parse with and without an EventLogger
+ * and print MB/s, nodes/s and peak RSS as tab-separated values
+ *
+ * Inputs larger than what fits in a QString comfortably are written to a temporary file and parsed with
+ * streaming parsing instead; those are only measured without EventLogger, and the traced row is printed as skipped.
+ * @return 0 on success, non-zero if any grammar name is invalid or any parse fails
+ */
+int runSynthetic(const SyntheticOptions& options);
+
+/**
+ * @brief stressDeepTree build a chain of nodes as deep as given, pass it through SimpleTreeTransform and
+ * SimpleTextGenerator, and check the node count and the text length of the results
+ *
+ * This checks that the tree walks do not recurse per tree level; the time and peak RSS of each stage are printed.
+ * @return 0 if every stage succeeds with the expected result, non-zero otherwise
+ */
+int stressDeepTree(int depth);
+
+/**
+ * @brief runTransformMemory transform a wide tree where every other node raises an error with one configuration:
+ * "lean" (no provenance, CodeOnly error recording) or "full" (provenance, All error recording)
+ *
+ * Peak RSS never decreases within a process, so each configuration must run in its own process to be compared;
+ * the peak RSS and the estimated size of the kept provenance and errors are printed.
+ * @return 0 if the configuration is known and the transform gives the expected number of nodes and errors
+ */
+int runTransformMemory(const QString& config, int numNodes);
+
+/**
+ * @brief checkTransformChain generate trees and chains of local transforms, and check that the fused walk of
+ * SimpleTreeTransformChain gives the same tree and success as applying the transforms one by one
+ *
+ * Case i is generated from seed i, so a failing case can be looked at alone.
+ * @return 0 if all cases match, non-zero otherwise
+ */
+int checkTransformChain(int numCases);
+
+/**
+ * @brief checkIncrementalTransform generate trees and transforms, apply random edits to each tree, and check that
+ * IncrementalTreeTransform::update() gives the same output, provenance, errors and success as a fresh reset()
+ *
+ * Case i is generated from seed i, so a failing case can be looked at alone.
+ * @return 0 if all cases match, non-zero otherwise
+ */
+int checkIncrementalTransform(int numCases);
+
+// parse sizes like "1K", "64M", "1G" (powers of 1024); returns -1 on invalid input
+qint64 parseSize(const QString& str);
+
+} // end namespace ParserBenchmark
+
+#endif // PARSERBENCHMARK_H
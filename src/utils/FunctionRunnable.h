@@ -0,0 +1,22 @@
+#ifndef FUNCTIONRUNNABLE_H
+#define FUNCTIONRUNNABLE_H
+
+#include <QRunnable>
+
+#include <functional>
+
+// QRunnable that runs a function; for handing lambdas to QThreadPool
+// only usable when PP_ENABLE_THREADS is defined
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(const std::function<void()>& f)
+        : func(f)
+    {}
+    virtual void run() override {func();}
+
+private:
+    std::function<void()> func;
+};
+
+#endif // FUNCTIONRUNNABLE_H
@@ -1,46 +1,38 @@
 #include "src/utils/TextUtilities.h"
 
+#include <algorithm>
+#include <cstring>
+
 TextUtil::TextPositionInfo::TextPositionInfo(const QString& text)
+    : str(text)
 {
-    int idx = 0;
-    int pos = 0;
-    lastLineFeedPos = -1;
-    int curPos = text.indexOf('\n', pos);
+}
+
+void TextUtil::TextPositionInfo::buildIndex() const
+{
+    lineFeedPosVec.clear();
+    lineFeedPosVec.reserve(str.count('\n'));
+    int curPos = str.indexOf('\n');
     while (curPos != -1) {
-        lineFeedPosMap.insert(curPos, idx);
-        lastLineFeedPos = curPos;
-        pos = curPos + 1;
-        idx += 1;
-        curPos = text.indexOf('\n', pos);
+        lineFeedPosVec.push_back(curPos);
+        curPos = str.indexOf('\n', curPos + 1);
     }
+    isIndexBuilt = true;
 }
 
 std::pair<int,int> TextUtil::TextPositionInfo::getLineAndColumnNumber(int pos) const
 {
     // if pos points to an '\n', we consider it as the last character in the last line
     // for example, if the string starts with '\n', then pos with 0 would give row 1, column 1
-    int lineNum = lineFeedPosMap.size();
-    int lfpos = lastLineFeedPos;
-    auto iter = lineFeedPosMap.lowerBound(pos);
-
-    // handle the case where pos is after the last line feed
-    if (iter == lineFeedPosMap.end()) {
-        Q_ASSERT(pos > lfpos);
-        return std::make_pair(lineNum+1, pos-lfpos);
+    if (!isIndexBuilt) {
+        buildIndex();
     }
 
-    // handle the case where pos is before / at the first line feed
-    if (iter == lineFeedPosMap.begin()) {
-        return std::make_pair(1, pos+1);
-    }
-
-    // handle the remaining case
-    --iter;
-
-    lineNum = iter.value();
-    lfpos = iter.key();
-
-    return std::make_pair(lineNum+2, pos-lfpos);
+    // number of line feeds before pos is the (0-based) line number
+    auto iter = std::lower_bound(lineFeedPosVec.begin(), lineFeedPosVec.end(), pos);
+    int lineIndex = static_cast<int>(iter - lineFeedPosVec.begin());
+    int lfpos = (lineIndex == 0)? -1 : lineFeedPosVec[lineIndex-1];
+    return std::make_pair(lineIndex+1, pos-lfpos);
 }
 
 QString TextUtil::TextPositionInfo::getLocationShortString(const QString& text, int pos) const
@@ -138,3 +130,60 @@ QString TextUtil::sanitizeSingleLineString(const QString& src)
     }
     return result;
 }
+
+bool TextUtil::validateUtf8(const char* data, qint64 size, bool* isAsciiOnly)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    bool isAscii = true;
+    qint64 i = 0;
+    while (i < size) {
+        // skip ASCII 8 bytes at a time
+        if (size - i >= 8) {
+            quint64 word;
+            std::memcpy(&word, p + i, sizeof(word));
+            if ((word & Q_UINT64_C(0x8080808080808080)) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        uchar c = p[i];
+        if (c < 0x80) {
+            i += 1;
+            continue;
+        }
+        isAscii = false;
+        int numContinuation = 0;
+        uint minValue = 0;
+        uint value = 0;
+        if ((c & 0xE0) == 0xC0) {
+            numContinuation = 1;
+            minValue = 0x80;
+            value = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            numContinuation = 2;
+            minValue = 0x800;
+            value = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            numContinuation = 3;
+            minValue = 0x10000;
+            value = c & 0x07;
+        } else {
+            return false;
+        }
+        if (size - i <= numContinuation)
+            return false;
+        for (int j = 1; j <= numContinuation; ++j) {
+            uchar cc = p[i + j];
+            if ((cc & 0xC0) != 0x80)
+                return false;
+            value = (value << 6) | (cc & 0x3F);
+        }
+        if (value < minValue || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+            return false;
+        i += numContinuation + 1;
+    }
+    if (isAsciiOnly) {
+        *isAsciiOnly = isAscii;
+    }
+    return true;
+}
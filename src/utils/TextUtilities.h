@@ -2,13 +2,17 @@
 #define TEXTPOSITIONINFO_H
 
 #include <QMap>
+#include <QString>
 #include <QCoreApplication>
 
+#include <vector>
+
 #include "src/GlobalInclude.h"
 
 namespace TextUtil {
 
 // given a string, compute the row and column number
+// the line feed index is built on first lookup; lookups are therefore not thread-safe
 class TextPositionInfo
 {
     Q_DECLARE_TR_FUNCTIONS(TextPositionInfo)
@@ -23,8 +27,12 @@ public:
     QString getLocationShortString(const QString& text, int pos) const;
 
 private:
-    QMap<int, int> lineFeedPosMap;
-    int lastLineFeedPos = -1;
+    void buildIndex() const;
+
+private:
+    QString str; // implicitly shared with the caller's string
+    mutable std::vector<int> lineFeedPosVec; // sorted positions of all line feeds
+    mutable bool isIndexBuilt = false;
 };
 
 /// The location type for plain text. It may either be a "point" or an "interval".
@@ -54,6 +62,10 @@ struct PlainTextLocation {
 /// make the string suitable for single line display, for example replacing new line characters with escaped form
 QString sanitizeSingleLineString(const QString& src);
 
+/// check whether the bytes are well-formed UTF-8 (no overlong forms, surrogates or code points above U+10FFFF)
+/// if isAsciiOnly is not null, it is set to whether all bytes are below 0x80
+bool validateUtf8(const char* data, qint64 size, bool* isAsciiOnly = nullptr);
+
 } // end namespace TextUtil
 
 Q_DECLARE_METATYPE(TextUtil::PlainTextLocation)